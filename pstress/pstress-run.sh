@@ -1901,6 +1901,9 @@ EOF
         CMD="$CMD --prepare"
         REINIT_DATADIR=0
       fi
+      if [ -n "${BASELINE_FILE}" ]; then
+        CMD="$CMD --compare-baseline=${BASELINE_FILE}"
+      fi
 
       echoit "$CMD"
       $CMD >${RUNDIR}/${TRIAL}/pstress.log 2>&1 &
@@ -2012,6 +2015,20 @@ EOF
   if [ ${ISSTARTED} -eq 1 -a ${TRIAL_SAVED} -ne 1 ]; then  # Do not try and print pstress log for a failed mysqld start
     if [ ${EXECUTE_SQL_FILES_MODE} -eq 0 ]; then
       echoit "pstress run details:$(grep -i 'SUMMARY.*queries failed' ${RUNDIR}/${TRIAL}/*.sql ${RUNDIR}/${TRIAL}/*.log 2>/dev/null | sed 's|.*:||')"
+      if [ -r ${RUNDIR}/${TRIAL}/step_${TRIAL}_summary.json ]; then
+        echoit "pstress run report: ${RUNDIR}/${TRIAL}/step_${TRIAL}_summary.json"
+      fi
+      if [ -n "${BASELINE_FILE}" ]; then
+        wait ${PQPID} 2>/dev/null  # pstress exits with 3 if it regressed against the baseline
+        PSTRESS_EXIT=$?
+        grep '^REGRESSION\|^Baseline comparison' ${RUNDIR}/${TRIAL}/pstress.log 2>/dev/null | while read -r line; do echoit "$line"; done
+        if [ ${PSTRESS_EXIT} -eq 3 ]; then
+          echoit "Performance regression against ${BASELINE_FILE} detected for this trial; saving this trial"
+          touch ${RUNDIR}/${TRIAL}/REGRESSION
+          savetrial
+          TRIAL_SAVED=1
+        fi
+      fi
     else
       echoit "SQL files execution mode: Trial ${TRIAL} completed"
     fi
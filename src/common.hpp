@@ -147,6 +147,33 @@ struct Option {
     FK_PROB,
     PARTITION_PROB,
     TEMPORARY_PROB,
+    TRACE,
+    TRACE_EVENTS,
+    METRICS_INTERVAL,
+    STALL_THRESHOLD,
+    STALL_THREADS,
+    COMPARE_BASELINE,
+    BASELINE_TOLERANCE,
+    BASELINE_ERROR_TOLERANCE,
+    DIGEST_TOP,
+    SERVER_TIMING_SAMPLE,
+    LOAD_DATA_INFILE,
+    LOAD_CHUNK_SIZE,
+    LOAD_PK_ORDER,
+    DDL_THREADS,
+    DDL_BUFFER_SIZE,
+    FAST_LOAD,
+    REUSE_DATASET,
+    TARGET_QPS,
+    ARRIVAL,
+    SCHEDULE_FILE,
+    KEY_DIST,
+    TABLE_KEY_DIST,
+    SHADOW_KEYS,
+    KEY_HIT_RATIO,
+    ROLES_FILE,
+    TABLE_AFFINITY,
+    AFFINITY_OVERLAP,
     MAX
   } option;
   Option(Type t, Opt o, std::string n)
@@ -268,7 +268,9 @@ void add_options() {
   opt = newOption(Option::INT, Option::INITIAL_RECORDS_IN_TABLE, "records");
   opt->help =
       "Number of initial records (N) in each table. The table will have random "
-      "records in range of 0 to N. Also check --exact-initial-records ";
+      "records in range of 0 to N, N is at most 2147483647. Primary keys "
+      "are computed from the record number so they need no client memory. "
+      "Also check --exact-initial-records ";
   opt->setInt(1000);
 
   /* Initial Records in table */
@@ -772,6 +774,195 @@ void add_options() {
       "with int columns of some table\n in database T1_VARCHAR_1, T1_VARCHAR_2 "
       "will be replaced with varchar columns of some table in database";
   opt->setString("grammar.sql");
+
+  /* client side tracing */
+  opt = newOption(Option::BOOL, Option::TRACE, "trace");
+  opt->help = "record per thread spans of each sql option with nested spans "
+              "of table_mutex waits, mysql_real_query, mysql_store_result and "
+              "logging, sql generation is the rest of the option. At exit they "
+              "are saved in Chrome trace-event format to "
+              "logdir/step_N_trace.json, open it in chrome://tracing or "
+              "ui.perfetto.dev";
+  opt->setBool(false);
+  opt->setArgs(no_argument);
+
+  /* maximum spans per thread */
+  opt = newOption(Option::INT, Option::TRACE_EVENTS, "trace-events");
+  opt->help = "maximum number of spans recorded per thread with --trace, "
+              "spans after that are dropped";
+  opt->setInt(500000);
+
+  /* metrics sampler */
+  opt = newOption(Option::INT, Option::METRICS_INTERVAL, "metrics-interval");
+  opt->help = "every N seconds sample client throughput together with "
+              "INNODB_METRICS, buffer pool and other global status, history "
+              "list length and pending metadata locks from a separate "
+              "connection. Samples are appended as JSON lines to "
+              "logdir/<node>_step_N_metrics.jsonl. 0 disables the sampler";
+  opt->setInt(0);
+
+  /* stall watchdog */
+  opt = newOption(Option::INT, Option::STALL_THRESHOLD, "stall-threshold");
+  opt->help = "watchdog reports a stall when --stall-threads threads have a "
+              "query running for more than N seconds. Processlist, innodb "
+              "status, lock waits, metadata locks and the sql in flight are "
+              "saved to logdir/<node>_step_N_stall_K.log and the stall is "
+              "marked in the --metrics-interval file. 0 disables the watchdog";
+  opt->setInt(0);
+
+  opt = newOption(Option::INT, Option::STALL_THREADS, "stall-threads");
+  opt->help = "number of threads running a query longer than "
+              "--stall-threshold to report a stall";
+  opt->setInt(1);
+
+  /* run summary and baseline comparison */
+  opt = newOption(Option::STRING, Option::COMPARE_BASELINE, "compare-baseline");
+  opt->help = "compare per option throughput, p95/p99 latency and error rate "
+              "with logdir/step_N_summary.json of an earlier run. Regressions "
+              "are printed and pstress exits with status 3";
+  opt->setString("");
+
+  opt = newOption(Option::INT, Option::BASELINE_TOLERANCE,
+                  "baseline-tolerance");
+  opt->help = "percentage of throughput drop or p95/p99 latency increase "
+              "allowed by --compare-baseline";
+  opt->setInt(10);
+
+  opt = newOption(Option::INT, Option::BASELINE_ERROR_TOLERANCE,
+                  "baseline-error-tolerance");
+  opt->help = "percentage points of error rate increase allowed by "
+              "--compare-baseline";
+  opt->setInt(1);
+
+  opt = newOption(Option::INT, Option::DIGEST_TOP, "digest-top");
+  opt->help = "number of statement shapes (option, table type, partition "
+              "clause and predicate) listed by total and by p99 latency in "
+              "the run summary";
+  opt->setInt(10);
+
+  opt = newOption(Option::INT, Option::SERVER_TIMING_SAMPLE,
+                  "server-timing-sample");
+  opt->help = "every N queries of a thread read the server execution time "
+              "from performance_schema.events_statements_history, the run "
+              "summary then shows how much of the query time is network and "
+              "client overhead. 0 disables sampling";
+  opt->setInt(0);
+
+  /* initial load */
+  opt = newOption(Option::BOOL, Option::LOAD_DATA_INFILE, "load-data-infile");
+  opt->help = "load initial records with LOAD DATA LOCAL INFILE, rows are "
+              "generated while the server reads them, no file is written. "
+              "Needs local_infile=ON on server, falls back to INSERT if it is "
+              "not enabled";
+  opt->setBool(false);
+  opt->setArgs(no_argument);
+
+  opt = newOption(Option::INT, Option::LOAD_CHUNK_SIZE, "load-chunk-size");
+  opt->help = "split initial records of tables in chunks of N rows that are "
+              "inserted by all threads in parallel, indexes and foreign keys "
+              "are added after all chunks are loaded. 0 loads each table in "
+              "one thread";
+  opt->setInt(0);
+
+  opt = newOption(Option::STRING, Option::LOAD_PK_ORDER, "load-pk-order");
+  opt->help = "order of primary keys in initial load. random inserts them "
+              "shuffled as earlier versions did and tests page split heavy "
+              "loads, asc inserts rows in ascending order and avoids B-tree "
+              "page splits";
+  opt->setString("random");
+
+  opt = newOption(Option::INT, Option::DDL_THREADS, "ddl-threads");
+  opt->help = "innodb_ddl_threads of the session that adds indexes after "
+              "initial load, 0 keeps server value. Needs 8.0.27";
+  opt->setInt(0);
+
+  opt = newOption(Option::INT, Option::DDL_BUFFER_SIZE, "ddl-buffer-size");
+  opt->help = "innodb_ddl_buffer_size in MB of the session that adds indexes "
+              "after initial load, 0 keeps server value. Needs 8.0.27";
+  opt->setInt(0);
+
+  opt = newOption(Option::BOOL, Option::FAST_LOAD, "fast-load");
+  opt->help = "during initial load set unique_checks=0, foreign_key_checks=0 "
+              "and on 8.0.21 or later disable redo log with ALTER INSTANCE. "
+              "Everything is restored before the workload starts. A server "
+              "crash during load with redo log disabled loses the datadir";
+  opt->setBool(false);
+  opt->setArgs(no_argument);
+
+  opt = newOption(Option::BOOL, Option::REUSE_DATASET, "reuse-dataset");
+  opt->help = "--prepare saves a fingerprint of metadata with row count and "
+              "checksum of tables in test.pstress_dataset. A later prepare or "
+              "step 1 with the same seed and options verifies the tables and "
+              "skips the load. Running workload discards the fingerprint";
+  opt->setBool(false);
+  opt->setArgs(no_argument);
+
+  opt = newOption(Option::INT, Option::TARGET_QPS, "target-qps");
+  opt->help = "start operations of all threads at this rate instead of "
+              "running the next one when the previous returns. Latency is "
+              "measured from the time an operation was due, and operations "
+              "started late are reported as backlog. 0 is closed loop";
+  opt->setInt(0);
+
+  opt = newOption(Option::STRING, Option::ARRIVAL, "arrival");
+  opt->help = "arrival of operations with --target-qps. uniform starts them "
+              "at fixed interval, poisson at random exponential intervals";
+  opt->setString("uniform");
+
+  opt = newOption(Option::STRING, Option::SCHEDULE_FILE, "schedule-file");
+  opt->help = "INI file with the phases of the workload, one section for each "
+              "phase in the order they run. Keys are seconds, threads, "
+              "target-qps, warmup (latency not in statistics), ramp (threads "
+              "and target-qps change linearly from previous phase) and "
+              "weights of sql options, e.g. select-single-row=800";
+  opt->setString("");
+
+  opt = newOption(Option::STRING, Option::KEY_DIST, "key-dist");
+  opt->help = "distribution of values of = and IN predicates on primary key "
+              "and indexed integer columns in select, update and delete. "
+              "uniform, zipf[:theta] (default 0.99), hotspot[:h[:a]] (h "
+              "percent of keys get a percent of accesses, default 10:90) or "
+              "latest[:theta] (recently inserted primary keys)";
+  opt->setString("uniform");
+
+  opt = newOption(Option::STRING, Option::TABLE_KEY_DIST, "table-key-dist");
+  opt->help = "--key-dist of some tables, e.g. tt_1=zipf:1.2,tt_2_p=latest";
+  opt->setString("");
+
+  opt = newOption(Option::BOOL, Option::SHADOW_KEYS, "shadow-keys");
+  opt->help = "keep a bitmap of primary keys present in each table, filled by "
+              "initial load and kept by insert, replace and delete, so point "
+              "select, update and delete can target existing rows. The bitmap "
+              "has a bit for each value of the key domain, records * 100, and "
+              "is allocated in shards of 128 KB as keys are added";
+  opt->setBool(false);
+  opt->setArgs(no_argument);
+
+  opt = newOption(Option::INT, Option::KEY_HIT_RATIO, "key-hit-ratio");
+  opt->help = "percent of primary key = predicates that use a key present in "
+              "table, with --shadow-keys";
+  opt->setInt(90);
+
+  opt = newOption(Option::STRING, Option::ROLES_FILE, "roles-file");
+  opt->help = "INI file with roles of threads, one section for each role. "
+              "Keys are threads, target-qps of the role and weights of the "
+              "sql options it runs, e.g. select-single-row=800. --threads is "
+              "the sum of the threads of the roles";
+  opt->setString("");
+
+  opt = newOption(Option::STRING, Option::TABLE_AFFINITY, "table-affinity");
+  opt->help = "tables picked by threads. shared is all tables for every "
+              "thread, disjoint deals the tables to the threads, FK children "
+              "with their parent, so they don't touch the same table. With "
+              "fewer tables than threads some threads share tables. overlap "
+              "is disjoint with "
+              "--affinity-overlap percent of operations on any table";
+  opt->setString("shared");
+
+  opt = newOption(Option::INT, Option::AFFINITY_OVERLAP, "affinity-overlap");
+  opt->help = "percent of operations of a thread on any table, with "
+              "--table-affinity=overlap";
+  opt->setInt(10);
 }
 
 Option::~Option() {}
@@ -0,0 +1,263 @@
+#include "keys.hpp"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+static std::vector<std::string> split(const std::string &str, char sep) {
+  std::vector<std::string> parts;
+  std::stringstream ss(str);
+  std::string part;
+  while (std::getline(ss, part, sep))
+    parts.push_back(part);
+  return parts;
+}
+
+static bool to_double(const std::string &str, double &value) {
+  char *end;
+  value = strtod(str.c_str(), &end);
+  return !str.empty() && *end == '\0';
+}
+
+bool Key_distribution::parse(const std::string &spec) {
+  auto parts = split(spec, ':');
+  if (parts.empty())
+    return false;
+  auto &name = parts[0];
+  if (name == "uniform" && parts.size() == 1) {
+    kind = UNIFORM;
+  } else if ((name == "zipf" || name == "latest") && parts.size() <= 2) {
+    kind = name == "zipf" ? ZIPF : LATEST;
+    if (parts.size() == 2 && (!to_double(parts[1], theta) || theta <= 0))
+      return false;
+  } else if (name == "hotspot" && parts.size() <= 3) {
+    kind = HOTSPOT;
+    double keys = 10, access = 90;
+    if (parts.size() >= 2 && !to_double(parts[1], keys))
+      return false;
+    if (parts.size() == 3 && !to_double(parts[2], access))
+      return false;
+    if (keys <= 0 || keys >= 100 || access < 0 || access > 100)
+      return false;
+    hot_keys = keys / 100;
+    hot_access = access / 100;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool key_dist_parse_tables(const std::string &list,
+                           std::map<std::string, Key_distribution> &tables) {
+  for (auto &entry : split(list, ',')) {
+    auto pos = entry.find('=');
+    if (pos == std::string::npos || pos == 0 ||
+        !tables[entry.substr(0, pos)].parse(entry.substr(pos + 1)))
+      return false;
+  }
+  return true;
+}
+
+/* helpers of rejection-inversion sampling, log1p(x)/x and expm1(x)/x that
+ * stay accurate around 0 */
+static double helper1(double x) {
+  if (std::abs(x) > 1e-8)
+    return std::log1p(x) / x;
+  return 1 - x * (0.5 - x * (1.0 / 3 - x * 0.25));
+}
+
+static double helper2(double x) {
+  if (std::abs(x) > 1e-8)
+    return std::expm1(x) / x;
+  return 1 + x * 0.5 * (1 + x * (1.0 / 3) * (1 + x * 0.25));
+}
+
+/* zipf by rejection-inversion (Hormann and Derflinger), it needs no table of
+ * the n keys and rejects rarely, so a sample is O(1) for any n */
+int64_t Key_distribution::zipf(int64_t n, std::mt19937 &gen) const {
+  auto h = [this](double x) { return std::exp(-theta * std::log(x)); };
+  auto h_integral = [this](double x) {
+    double log_x = std::log(x);
+    return helper2((1 - theta) * log_x) * log_x;
+  };
+  auto h_integral_inverse = [this](double x) {
+    double t = std::max(x * (1 - theta), -1.0);
+    return std::exp(helper1(t) * x);
+  };
+
+  double h_integral_x1 = h_integral(1.5) - 1;
+  double h_integral_n = h_integral(n + 0.5);
+  double s = 2 - h_integral_inverse(h_integral(2.5) - h(2));
+  std::uniform_real_distribution<double> uniform(0, 1);
+  while (true) {
+    double u = h_integral_n + uniform(gen) * (h_integral_x1 - h_integral_n);
+    double x = h_integral_inverse(u);
+    auto k = static_cast<int64_t>(x + 0.5);
+    k = std::min(std::max<int64_t>(k, 1), n);
+    if (k - x <= s || u >= h_integral(k + 0.5) - h(k))
+      return k - 1;
+  }
+}
+
+int64_t Key_distribution::next(int64_t n, std::mt19937 &gen) const {
+  switch (kind) {
+  case UNIFORM:
+    break;
+  case ZIPF:
+  case LATEST:
+    return zipf(n, gen);
+  case HOTSPOT: {
+    auto hot = std::max<int64_t>(n * hot_keys, 1);
+    std::uniform_real_distribution<double> access(0, 1);
+    if (hot < n && access(gen) >= hot_access)
+      return std::uniform_int_distribution<int64_t>(hot, n - 1)(gen);
+    return std::uniform_int_distribution<int64_t>(0, hot - 1)(gen);
+  }
+  }
+  return std::uniform_int_distribution<int64_t>(0, n - 1)(gen);
+}
+
+__extension__ typedef unsigned __int128 uint128;
+
+/* first number from start that is coprime to n, so multiplying by it modulo n
+ * is a bijection */
+static uint64_t coprime_multiplier(uint64_t n, uint64_t start) {
+  auto gcd = [](uint64_t a, uint64_t b) {
+    while (b != 0) {
+      auto r = a % b;
+      a = b;
+      b = r;
+    }
+    return a;
+  };
+  uint64_t m = start % n;
+  while (gcd(m, n) != 1)
+    m = (m + 1) % n;
+  return m;
+}
+
+int64_t key_scatter(int64_t rank, int64_t n) {
+  /* domain of the last caller, threads mostly scatter over the same one */
+  thread_local uint64_t domain = 0, multiplier = 0;
+  if (domain != static_cast<uint64_t>(n)) {
+    domain = n;
+    multiplier = coprime_multiplier(domain, 0x9E3779B97F4A7C15ULL);
+  }
+  return static_cast<int64_t>(static_cast<uint128>(rank + 1) * multiplier %
+                              domain);
+}
+
+/* splitmix64 finalizer */
+static uint64_t mix(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+Load_keys::Load_keys(int64_t records, int64_t domain, bool ascending,
+                     uint64_t seed)
+    : records_(records), domain_(domain), ascending_(ascending), seed_(seed) {
+  if (records_ > 0 && !ascending_) {
+    multiplier_ = coprime_multiplier(records_, mix(seed_) | 1);
+    offset_ = mix(seed_ + 1) % records_;
+  }
+}
+
+int64_t Load_keys::at(int64_t index) const {
+  uint64_t slot = index;
+  if (!ascending_)
+    slot = (static_cast<uint128>(slot) * multiplier_ + offset_) % records_;
+  uint64_t begin = static_cast<uint128>(slot) * domain_ / records_;
+  uint64_t end = static_cast<uint128>(slot + 1) * domain_ / records_;
+  return begin + mix(seed_ ^ slot) % (end - begin) + 1;
+}
+
+bool Recent_keys::pick(const Key_distribution &dist, std::mt19937 &gen,
+                       int64_t &key) const {
+  uint64_t inserted = count;
+  if (inserted == 0)
+    return false;
+  auto age = dist.next(std::min<uint64_t>(inserted, SIZE), gen);
+  key = keys[(inserted - 1 - age) % SIZE];
+  return true;
+}
+
+Key_set::Key_set(int64_t size)
+    : size_(size), words_((size + 63) / 64),
+      shard_count_((words_ + SHARD_WORDS - 1) / SHARD_WORDS),
+      shards(new std::atomic<std::atomic<uint64_t> *>[shard_count_]) {
+  for (size_t i = 0; i < shard_count_; i++)
+    shards[i] = nullptr;
+}
+
+Key_set::~Key_set() {
+  for (size_t i = 0; i < shard_count_; i++)
+    delete[] shards[i].load();
+}
+
+std::atomic<uint64_t> *Key_set::word(size_t index, bool allocate) const {
+  auto &shard = shards[index / SHARD_WORDS];
+  auto words = shard.load(std::memory_order_acquire);
+  if (words == nullptr && allocate) {
+    /* last shard only covers the end of the domain */
+    auto first = index / SHARD_WORDS * SHARD_WORDS;
+    auto count = std::min(SHARD_WORDS, words_ - first);
+    auto fresh = new std::atomic<uint64_t>[count];
+    for (size_t i = 0; i < count; i++)
+      fresh[i] = 0;
+    if (shard.compare_exchange_strong(words, fresh))
+      words = fresh;
+    else
+      delete[] fresh;
+  }
+  return words == nullptr ? nullptr : &words[index % SHARD_WORDS];
+}
+
+void Key_set::add(int64_t key) {
+  if (key >= 0 && key < size_)
+    word(key / 64, true)->fetch_or(uint64_t(1) << (key % 64));
+}
+
+void Key_set::remove(int64_t key) {
+  if (key < 0 || key >= size_)
+    return;
+  auto bits = word(key / 64, false);
+  if (bits != nullptr)
+    bits->fetch_and(~(uint64_t(1) << (key % 64)));
+}
+
+/* shards stay allocated, other threads may be reading them */
+void Key_set::clear() {
+  for (size_t i = 0; i < shard_count_; i++) {
+    auto words = shards[i].load(std::memory_order_acquire);
+    if (words == nullptr)
+      continue;
+    auto count = std::min(SHARD_WORDS, words_ - i * SHARD_WORDS);
+    for (size_t j = 0; j < count; j++)
+      words[j] = 0;
+  }
+}
+
+/* a shard not allocated has no key and is skipped as one word */
+bool Key_set::find(int64_t start, int64_t &key) const {
+  if (start < 0 || start >= size_)
+    return false;
+  size_t index = start / 64;
+  auto bits = word(index, false);
+  uint64_t set = bits == nullptr
+                     ? 0
+                     : bits->load() & (~uint64_t(0) << (start % 64));
+  for (size_t i = 0; i <= std::min(SCAN_WORDS, words_); i++) {
+    if (set != 0) {
+      key = index * 64 + __builtin_ctzll(set);
+      return true;
+    }
+    index = bits == nullptr ? (index / SHARD_WORDS + 1) * SHARD_WORDS
+                            : index + 1;
+    if (index >= words_)
+      index = 0;
+    bits = word(index, false);
+    set = bits == nullptr ? 0 : bits->load();
+  }
+  return false;
+}
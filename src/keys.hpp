@@ -0,0 +1,132 @@
+#ifndef __KEYS_HPP__
+#define __KEYS_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+
+/* Distribution of the keys of point predicates, set by --key-dist. It picks a
+rank in [0, n), rank 0 is the hottest key. Every kind samples in O(1)
+  uniform          all keys equally
+  zipf[:theta]     rank r with probability proportional to 1/(r+1)^theta
+  hotspot[:h[:a]]  h percent of keys get a percent of accesses
+  latest[:theta]   keys last inserted in table, zipf over their age */
+class Key_distribution {
+public:
+  enum Kind { UNIFORM, ZIPF, HOTSPOT, LATEST };
+
+  /* @return false if spec is not valid */
+  bool parse(const std::string &spec);
+
+  /* rank in [0, n), latest is sampled as zipf over age */
+  int64_t next(int64_t n, std::mt19937 &gen) const;
+
+  Kind kind = UNIFORM;
+
+private:
+  int64_t zipf(int64_t n, std::mt19937 &gen) const;
+
+  double theta = 0.99;
+  double hot_keys = 0.1;   // fraction of keys that are hot
+  double hot_access = 0.9; // fraction of accesses to hot keys
+};
+
+/* parse --table-key-dist, a list of table=spec separated by comma
+@return false if some entry is not valid */
+bool key_dist_parse_tables(const std::string &list,
+                           std::map<std::string, Key_distribution> &tables);
+
+/* spread ranks over [0, n), so hot keys are not all at the start of the key
+ * domain. It is a permutation of [0, n), every rank has its own key */
+int64_t key_scatter(int64_t rank, int64_t n);
+
+/* primary keys of the initial records of a table in [1, domain]. They are
+computed from the index of the record, so tables larger than memory need no
+key storage and FK child tables pick keys of parent on demand. The domain is
+split in one slot per record and a record takes a random key of its slot, so
+keys are unique. Records take the slots in order when ascending, else in the
+order of a permutation of the records seeded by the table */
+class Load_keys {
+public:
+  Load_keys() {}
+  Load_keys(int64_t records, int64_t domain, bool ascending, uint64_t seed);
+
+  /* key of the record at index, in [0, size()) */
+  int64_t at(int64_t index) const;
+  int64_t size() const { return records_; }
+
+private:
+  int64_t records_ = 0;
+  int64_t domain_ = 0; // domain is at least records
+  bool ascending_ = true;
+  uint64_t seed_ = 0;
+  uint64_t multiplier_ = 1; // permutation of records, coprime to records
+  uint64_t offset_ = 0;
+};
+
+/* primary keys last inserted in a table, for --key-dist=latest */
+class Recent_keys {
+public:
+  static const size_t SIZE = 1024;
+
+  void add(int64_t key) { keys[count++ % SIZE] = key; }
+
+  /* pick a recent key, newer keys more often
+  @return false if no key is inserted yet */
+  bool pick(const Key_distribution &dist, std::mt19937 &gen,
+            int64_t &key) const;
+
+private:
+  std::atomic<int64_t> keys[SIZE] = {};
+  std::atomic<uint64_t> count{0};
+};
+
+/* Primary keys present in a table, for --shadow-keys. It is a bitmap over the
+key domain split in shards of SHARD_KEYS keys, a shard is allocated when its
+first key is added, so parts of the domain without keys take no memory. 64 bit
+words are updated atomically and shards are published with a CAS, so threads
+never lock. It follows successful statements and is only a hint, rows removed
+by rollback or partition DDL are found missing by later point statements */
+class Key_set {
+public:
+  static const int64_t SHARD_KEYS = int64_t(1) << 20; // 128 KB of bits
+
+  /* keys in [0, size) */
+  explicit Key_set(int64_t size);
+  ~Key_set();
+  Key_set(const Key_set &) = delete;
+  Key_set &operator=(const Key_set &) = delete;
+
+  void add(int64_t key);
+  void remove(int64_t key);
+  void clear();
+
+  /* first key present at or after start, wrapping around at the end. At most
+  SCAN_WORDS words are looked at, so the cost is bounded in sparse sets
+  @return false if no key is found */
+  bool find(int64_t start, int64_t &key) const;
+
+  int64_t size() const { return size_; }
+  /* bytes of the bitmap once keys are added in every shard */
+  int64_t max_bytes() const { return static_cast<int64_t>(words_) * 8; }
+
+  std::atomic<bool> seeding{false}; // a thread is filling the set
+  std::atomic<bool> ready{false};   // set has the keys of the table
+
+private:
+  static const size_t SCAN_WORDS = 1024;
+  static const size_t SHARD_WORDS = SHARD_KEYS / 64;
+
+  /* word of the bitmap, nullptr if its shard is not allocated */
+  std::atomic<uint64_t> *word(size_t index, bool allocate) const;
+
+  int64_t size_;
+  size_t words_;
+  size_t shard_count_;
+  std::unique_ptr<std::atomic<std::atomic<uint64_t> *>[]> shards;
+};
+
+#endif
@@ -0,0 +1,546 @@
+#include "common.hpp"
+#include "node.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <map>
+#include <pthread.h>
+#include <signal.h>
+#include <stringbuffer.h>
+
+using namespace rapidjson;
+
+/* nodes with running workers, for the live snapshot */
+static std::mutex snapshot_nodes_mutex;
+static std::vector<Node *> snapshot_nodes;
+/* not destroyed at exit, as a joinable thread would terminate the process if
+ * pstress exits without stop_snapshot_thread() */
+static std::thread *snapshot_thread = nullptr;
+static std::atomic<bool> snapshot_stop(false);
+
+/* global status sampled with --metrics-interval, in addition to all the
+ * Innodb_buffer_pool% variables */
+static const char *sampled_status[] = {
+    "Threads_running",
+    "Threads_connected",
+    "Questions",
+    "Innodb_row_lock_current_waits",
+    "Innodb_row_lock_waits",
+    "Innodb_row_lock_time",
+    "Innodb_data_fsyncs",
+    "Innodb_os_log_written",
+    "Innodb_redo_log_current_lsn",
+    "Innodb_redo_log_checkpoint_lsn",
+    "Table_open_cache_misses"};
+
+/* run sql on a monitoring connection
+@return result set, it is empty if query failed or did not return rows */
+static std::shared_ptr<MYSQL_RES> monitor_query(MYSQL *conn,
+                                                const std::string &sql) {
+  MYSQL_RES *result = nullptr;
+  if (mysql_real_query(conn, sql.c_str(), sql.size()) == 0)
+    result = mysql_store_result(conn);
+  return std::shared_ptr<MYSQL_RES>(result, [](MYSQL_RES *r) {
+    if (r)
+      mysql_free_result(r);
+  });
+}
+
+/* read a two column result set of name, number. Rows whose value is text,
+ * e.g. Innodb_buffer_pool_dump_status, are skipped */
+static std::map<std::string, long long>
+monitor_name_values(MYSQL *conn, const std::string &sql) {
+  std::map<std::string, long long> values;
+  auto result = monitor_query(conn, sql);
+  if (!result || mysql_num_fields(result.get()) < 2)
+    return values;
+  MYSQL_ROW row;
+  while ((row = mysql_fetch_row(result.get())) != nullptr) {
+    if (row[0] == nullptr || row[1] == nullptr)
+      continue;
+    char *end;
+    long long value = std::strtoll(row[1], &end, 10);
+    if (end != row[1] && *end == '\0')
+      values[row[0]] = value;
+  }
+  return values;
+}
+
+/* write the wall clock time of the sample, it is in the same format as
+ * --log-query-duration so samples can be matched with query logs */
+static void write_time(Writer<StringBuffer> &writer) {
+  auto now = std::chrono::system_clock::now();
+  auto now_t = std::chrono::system_clock::to_time_t(now);
+  std::ostringstream time;
+  time << std::put_time(std::localtime(&now_t), "%Y-%m-%dT%X");
+  writer.String("time");
+  writer.String(time.str().c_str());
+  writer.String("ts_ms");
+  writer.Int64(std::chrono::duration_cast<std::chrono::milliseconds>(
+                   now.time_since_epoch())
+                   .count());
+}
+
+/* open a new connection to the node for the monitoring threads
+@return nullptr on error */
+MYSQL *Node::sideConnection() {
+  MYSQL *conn = mysql_init(NULL);
+  if (conn == NULL)
+    return nullptr;
+  if (mysql_real_connect(conn, myParams.address.c_str(),
+                         myParams.username.c_str(), myParams.password.c_str(),
+                         myParams.database.c_str(), myParams.port,
+                         myParams.socket.c_str(), 0) == NULL) {
+    std::cerr << "Monitoring connection to " << myParams.myName
+              << " failed. Error " << mysql_errno(conn) << ": "
+              << mysql_error(conn) << std::endl;
+    mysql_close(conn);
+    return nullptr;
+  }
+  return conn;
+}
+
+/* append one JSON line to the metrics file of the node */
+void Node::writeMetrics(const std::string &line) {
+  std::lock_guard<std::mutex> lock(metrics_log_mutex);
+  if (metrics_log.is_open())
+    metrics_log << line << std::endl;
+}
+
+void Node::startMonitors() {
+  {
+    std::lock_guard<std::mutex> lock(snapshot_nodes_mutex);
+    snapshot_nodes.push_back(this);
+  }
+
+  if (options->at(Option::STALL_THRESHOLD)->getInt() > 0)
+    monitors.emplace_back(&Node::watchdogThread, this);
+
+  if (options->at(Option::METRICS_INTERVAL)->getInt() <= 0)
+    return;
+
+  std::string logName = myParams.logdir + "/" + myParams.myName + "_step_" +
+                        std::to_string(options->at(Option::STEP)->getInt()) +
+                        "_metrics.jsonl";
+  metrics_log.open(logName, std::ios::out | std::ios::trunc);
+  if (!metrics_log.is_open()) {
+    std::cerr << "Unable to open metrics file " << logName << ": "
+              << std::strerror(errno) << std::endl;
+    return;
+  }
+  general_log << "- Writing metrics every "
+              << options->at(Option::METRICS_INTERVAL)->getInt()
+              << " seconds to " << logName << std::endl;
+  monitors.emplace_back(&Node::metricsThread, this);
+}
+
+void Node::stopMonitors() {
+  {
+    std::lock_guard<std::mutex> lock(snapshot_nodes_mutex);
+    snapshot_nodes.erase(
+        std::find(snapshot_nodes.begin(), snapshot_nodes.end(), this));
+  }
+  {
+    std::lock_guard<std::mutex> lock(monitor_mutex);
+    monitor_stop = true;
+  }
+  monitor_cv.notify_all();
+  for (auto &monitor : monitors)
+    monitor.join();
+  monitors.clear();
+  if (metrics_log.is_open())
+    metrics_log.close();
+}
+
+/* sample client throughput and server metrics every --metrics-interval
+ * seconds till worker threads finish */
+void Node::metricsThread() {
+  auto interval =
+      std::chrono::seconds(options->at(Option::METRICS_INTERVAL)->getInt());
+  MYSQL *conn = sideConnection();
+
+  unsigned long long last_performed = performed_queries_total;
+  unsigned long long last_failed = failed_queries_total;
+  auto last_sample = std::chrono::steady_clock::now();
+
+  std::unique_lock<std::mutex> lock(monitor_mutex);
+  while (
+      !monitor_cv.wait_for(lock, interval, [this] { return monitor_stop; })) {
+    lock.unlock();
+
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - last_sample).count();
+    unsigned long long performed = performed_queries_total;
+    unsigned long long failed = failed_queries_total;
+
+    StringBuffer line;
+    Writer<StringBuffer> writer(line);
+    writer.StartObject();
+    write_time(writer);
+    writer.String("type");
+    writer.String("sample");
+
+    writer.String("client");
+    writer.StartObject();
+    writer.String("queries");
+    writer.Uint64(performed - last_performed);
+    writer.String("failed");
+    writer.Uint64(failed - last_failed);
+    writer.String("qps");
+    writer.Double(seconds > 0 ? (performed - last_performed) / seconds : 0);
+    writer.String("failed_qps");
+    writer.Double(seconds > 0 ? (failed - last_failed) / seconds : 0);
+    writer.EndObject();
+
+    /* reconnect if the server was restarted or connection was lost */
+    if (conn != nullptr && mysql_ping(conn) != 0) {
+      mysql_close(conn);
+      conn = nullptr;
+    }
+    if (conn == nullptr)
+      conn = sideConnection();
+
+    if (conn != nullptr) {
+      writer.String("server");
+      writer.StartObject();
+
+      auto metrics = monitor_name_values(
+          conn, "SELECT NAME, COUNT FROM information_schema.INNODB_METRICS "
+                "WHERE STATUS = 'enabled'");
+      auto history = metrics.find("trx_rseg_history_len");
+      if (history != metrics.end()) {
+        writer.String("history_list_length");
+        writer.Int64(history->second);
+      }
+
+      std::string status_sql =
+          "SELECT VARIABLE_NAME, VARIABLE_VALUE FROM "
+          "performance_schema.global_status WHERE VARIABLE_NAME LIKE "
+          "'Innodb_buffer_pool%' OR VARIABLE_NAME IN (";
+      for (size_t i = 0; i < sizeof(sampled_status) / sizeof(char *); i++)
+        status_sql += std::string(i ? "," : "") + "'" + sampled_status[i] + "'";
+      status_sql += ")";
+      auto status = monitor_name_values(conn, status_sql);
+      auto current_lsn = status.find("Innodb_redo_log_current_lsn");
+      auto checkpoint_lsn = status.find("Innodb_redo_log_checkpoint_lsn");
+      if (current_lsn != status.end() && checkpoint_lsn != status.end()) {
+        writer.String("checkpoint_age");
+        writer.Int64(current_lsn->second - checkpoint_lsn->second);
+      }
+
+      auto mdl = monitor_name_values(
+          conn, "SELECT 'pending', COUNT(*) FROM "
+                "performance_schema.metadata_locks WHERE LOCK_STATUS = "
+                "'PENDING'");
+      if (mdl.count("pending")) {
+        writer.String("mdl_waits");
+        writer.Int64(mdl["pending"]);
+      }
+
+      writer.String("status");
+      writer.StartObject();
+      for (auto &var : status) {
+        writer.String(var.first.c_str());
+        writer.Int64(var.second);
+      }
+      writer.EndObject();
+
+      writer.String("innodb_metrics");
+      writer.StartObject();
+      for (auto &metric : metrics) {
+        writer.String(metric.first.c_str());
+        writer.Int64(metric.second);
+      }
+      writer.EndObject();
+      writer.EndObject();
+    }
+    writer.EndObject();
+    writeMetrics(line.GetString());
+
+    last_performed = performed;
+    last_failed = failed;
+    last_sample = now;
+    lock.lock();
+  }
+
+  if (conn != nullptr)
+    mysql_close(conn);
+  mysql_thread_end();
+}
+
+/* milli-seconds of steady_clock, same clock as Thd1::query_start */
+static uint64_t steady_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/* write the result set of sql as tab separated rows with a header */
+static void dump_query(MYSQL *conn, const std::string &sql,
+                       std::ofstream &out) {
+  out << "==== " << sql << std::endl;
+  auto result = monitor_query(conn, sql);
+  if (!result) {
+    out << "Error " << mysql_errno(conn) << ": " << mysql_error(conn)
+        << std::endl
+        << std::endl;
+    return;
+  }
+  unsigned int fields = mysql_num_fields(result.get());
+  MYSQL_FIELD *field;
+  while ((field = mysql_fetch_field(result.get())) != nullptr)
+    out << field->name << "\t";
+  out << std::endl;
+  MYSQL_ROW row;
+  while ((row = mysql_fetch_row(result.get())) != nullptr) {
+    for (unsigned int i = 0; i < fields; i++)
+      out << (row[i] ? row[i] : "NULL") << "\t";
+    out << std::endl;
+  }
+  out << std::endl;
+}
+
+/* save the state of the server and of the client threads during a stall */
+void Node::captureStall(const std::string &file,
+                        const std::vector<std::string> &in_flight) {
+  std::ofstream out(file, std::ios::out | std::ios::trunc);
+  if (!out.is_open()) {
+    std::cerr << "Unable to open stall file " << file << ": "
+              << std::strerror(errno) << std::endl;
+    return;
+  }
+  out << "==== queries in flight" << std::endl;
+  for (auto &query : in_flight)
+    out << query << std::endl;
+  out << std::endl;
+
+  MYSQL *conn = sideConnection();
+  if (conn == nullptr) {
+    out << "Unable to connect to the server to capture its state" << std::endl;
+    return;
+  }
+  dump_query(conn, "SHOW FULL PROCESSLIST", out);
+  dump_query(conn, "SHOW ENGINE INNODB STATUS", out);
+  dump_query(conn, "SELECT * FROM performance_schema.data_lock_waits", out);
+  dump_query(conn, "SELECT * FROM performance_schema.metadata_locks", out);
+  mysql_close(conn);
+}
+
+/* check every second for threads having a query in flight longer than
+ * --stall-threshold. When --stall-threads of them are found capture the
+ * diagnostics once, and again only after the stall clears */
+void Node::watchdogThread() {
+  uint64_t threshold = options->at(Option::STALL_THRESHOLD)->getInt() * 1000;
+  size_t stall_threads = options->at(Option::STALL_THREADS)->getInt();
+  int stalls = 0;
+  uint64_t stall_start = 0;
+
+  std::unique_lock<std::mutex> lock(monitor_mutex);
+  while (!monitor_cv.wait_for(lock, std::chrono::seconds(1),
+                              [this] { return monitor_stop; })) {
+    lock.unlock();
+
+    uint64_t now = steady_ms();
+    size_t stalled = 0;
+    std::vector<std::string> in_flight;
+    {
+      std::lock_guard<std::mutex> thds_lock(thds_mutex);
+      for (auto thd : thds) {
+        std::lock_guard<std::mutex> query_lock(thd->in_flight_mutex);
+        uint64_t start = thd->query_start;
+        if (start == 0 || thd->in_flight_sql == nullptr)
+          continue;
+        uint64_t age = now > start ? now - start : 0;
+        if (age > threshold)
+          stalled++;
+        in_flight.push_back("thread-" + std::to_string(thd->thread_id) +
+                            " running for " + std::to_string(age) + "ms: " +
+                            *thd->in_flight_sql);
+      }
+    }
+
+    if (stall_start == 0 && stalled >= stall_threads) {
+      stall_start = now;
+      stalls++;
+      std::string file = myParams.logdir + "/" + myParams.myName + "_step_" +
+                         std::to_string(options->at(Option::STEP)->getInt()) +
+                         "_stall_" + std::to_string(stalls) + ".log";
+      std::cerr << "Stall detected on " << myParams.myName << ", " << stalled
+                << " threads running a query for more than "
+                << threshold / 1000 << " seconds, saving diagnostics to "
+                << file << std::endl;
+
+      StringBuffer line;
+      Writer<StringBuffer> writer(line);
+      writer.StartObject();
+      write_time(writer);
+      writer.String("type");
+      writer.String("stall");
+      writer.String("threads");
+      writer.Uint64(stalled);
+      writer.String("file");
+      writer.String(file.c_str());
+      writer.EndObject();
+      writeMetrics(line.GetString());
+
+      captureStall(file, in_flight);
+    } else if (stall_start != 0 && stalled < stall_threads) {
+      std::cerr << "Stall on " << myParams.myName << " cleared after "
+                << (now - stall_start) / 1000 << " seconds" << std::endl;
+
+      StringBuffer line;
+      Writer<StringBuffer> writer(line);
+      writer.StartObject();
+      write_time(writer);
+      writer.String("type");
+      writer.String("stall_end");
+      writer.String("duration_ms");
+      writer.Uint64(now - stall_start);
+      writer.EndObject();
+      writeMetrics(line.GetString());
+      stall_start = 0;
+    }
+    lock.lock();
+  }
+  mysql_thread_end();
+}
+
+void Node::writeSnapshot(std::ostream &out) {
+  uint64_t now = steady_ms();
+  out << myParams.myName << ": " << performed_queries_total << " queries, "
+      << failed_queries_total << " failed" << std::endl;
+  std::lock_guard<std::mutex> lock(thds_mutex);
+  for (auto thd : thds) {
+    int option = thd->current_option.load(std::memory_order_relaxed);
+    uint64_t start = thd->query_start.load(std::memory_order_relaxed);
+    out << "  thread-" << thd->thread_id << ": "
+        << (option >= 0 ? options->at(option)->getName() : "-");
+    if (start != 0)
+      out << ", query running for " << (now > start ? now - start : 0)
+          << "ms";
+    out << std::endl;
+  }
+}
+
+void Node::addOptionCounts(std::vector<Option_counts> &counts) {
+  std::lock_guard<std::mutex> lock(thds_mutex);
+  auto add = [&counts](size_t option, const Option_counts &more) {
+    counts[option].total += more.total;
+    counts[option].success += more.success;
+    counts[option].us += more.us;
+  };
+  for (size_t i = 0; i < finished_counts.size(); i++)
+    add(i, finished_counts[i]);
+  for (auto thd : thds) {
+    for (int i = 0; i < Option::MAX; i++)
+      add(i, thd->option_counts(i));
+  }
+}
+
+/* wait for SIGUSR1 and print a snapshot of the run. The signal is blocked in
+ * all threads and received here with sigwait(), so the snapshot is not
+ * written from a signal handler and the workers are not interrupted */
+static void snapshot_signal_thread(sigset_t set) {
+  auto start = std::chrono::steady_clock::now();
+  auto last = start;
+  /* counters of the options at the previous snapshot */
+  std::vector<Option_counts> previous(options->size());
+  std::string file = options->at(Option::LOGDIR)->getString() + "/step_" +
+                     std::to_string(options->at(Option::STEP)->getInt()) +
+                     "_snapshot.log";
+
+  while (true) {
+    int sig;
+    if (sigwait(&set, &sig) != 0)
+      continue;
+    if (snapshot_stop)
+      break;
+
+    auto now = std::chrono::steady_clock::now();
+    double since_start = std::chrono::duration<double>(now - start).count();
+    double since_last = std::chrono::duration<double>(now - last).count();
+    auto now_t = std::chrono::system_clock::to_time_t(
+        std::chrono::system_clock::now());
+
+    std::ostringstream out;
+    out.precision(1);
+    out << std::fixed;
+    out << "==== snapshot at "
+        << std::put_time(std::localtime(&now_t), "%Y-%m-%dT%X") << ", "
+        << since_start << "s since start, " << since_last
+        << "s since last snapshot" << std::endl;
+
+    if (!options->at(Option::PQUERY)->getBool()) {
+      if (!metadata_loaded) {
+        out << "metadata: loading" << std::endl;
+      } else {
+        size_t done, total;
+        load_progress(done, total);
+        out << "metadata: loaded, " << done << "/" << total
+            << " tables loaded or checked" << std::endl;
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(snapshot_nodes_mutex);
+      for (auto node : snapshot_nodes)
+        node->writeSnapshot(out);
+    }
+
+    /* operations summed over the threads of all nodes */
+    std::vector<Option_counts> counts(options->size());
+    {
+      std::lock_guard<std::mutex> lock(snapshot_nodes_mutex);
+      for (auto node : snapshot_nodes)
+        node->addOptionCounts(counts);
+    }
+
+    out << std::left << std::setw(32) << "option" << std::right
+        << std::setw(10) << "total" << std::setw(10) << "failed"
+        << std::setw(10) << "qps" << std::setw(10) << "avg_us"
+        << std::setw(10) << "last_qps" << std::setw(10) << "last_avg"
+        << std::endl;
+    for (size_t i = 0; i < options->size(); i++) {
+      auto opt = options->at(i);
+      auto &current = counts[i];
+      if (opt == nullptr || current.total == 0)
+        continue;
+      unsigned long delta = current.total - previous[i].total;
+      out << std::left << std::setw(32) << opt->getName() << std::right
+          << std::setw(10) << current.total << std::setw(10)
+          << current.total - current.success << std::setw(10)
+          << current.total / since_start << std::setw(10)
+          << current.us / current.total << std::setw(10)
+          << delta / since_last << std::setw(10)
+          << (delta ? (current.us - previous[i].us) / delta : 0) << std::endl;
+      previous[i] = current;
+    }
+    last = now;
+
+    std::cerr << out.str();
+    std::ofstream of(file, std::ios::out | std::ios::app);
+    if (of.is_open())
+      of << out.str();
+  }
+}
+
+void start_snapshot_thread() {
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  /* threads created later inherit the mask */
+  pthread_sigmask(SIG_BLOCK, &set, nullptr);
+  snapshot_thread = new std::thread(snapshot_signal_thread, set);
+}
+
+void stop_snapshot_thread() {
+  if (snapshot_thread == nullptr)
+    return;
+  snapshot_stop = true;
+  pthread_kill(snapshot_thread->native_handle(), SIGUSR1);
+  snapshot_thread->join();
+  delete snapshot_thread;
+  snapshot_thread = nullptr;
+}
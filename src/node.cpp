@@ -9,10 +9,17 @@ Node::Node() {
   workers.clear();
   performed_queries_total = 0;
   failed_queries_total = 0;
+  monitor_stop = false;
+  start_time = std::chrono::steady_clock::now();
 }
 
 void Node::end_node() {
   writeFinalReport();
+  stats_add_node({myParams.myName, server_version, performed_queries_total,
+                  failed_queries_total,
+                  std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start_time)
+                      .count()});
   if (general_log)
     general_log.close();
   if (options->at(Option::PQUERY)->getBool() && querylist)
@@ -116,10 +123,12 @@ int Node::startWork() {
   for (int i = 0; i < myParams.threads; i++) {
     workers[i] = std::thread(&Node::workerThread, this, i);
   }
+  startMonitors();
 
   for (int i = 0; i < myParams.threads; i++) {
     workers[i].join();
   }
+  stopMonitors();
   return EXIT_SUCCESS;
 }
 
@@ -155,7 +164,6 @@ void Node::tryConnect() {
               << std::endl;
   // getting the real server version
   MYSQL_RES *result = NULL;
-  std::string server_version;
 
   if (!mysql_query(conn, "select @@version_comment limit 1") &&
       (result = mysql_use_result(conn))) {
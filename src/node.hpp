@@ -4,8 +4,11 @@
 #include "pstress.hpp"
 #include "random_test.hpp"
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <mysql.h>
 #include <sstream>
 #include <string>
@@ -54,6 +57,14 @@ enum LogLevel {
   LOG_CURRENT = LOG_NOTHING
 };
 
+extern std::atomic<bool> metadata_loaded;
+
+/* live snapshot of all nodes printed on SIGUSR1, defined in monitor.cpp.
+ * start_snapshot_thread() blocks SIGUSR1 in the calling thread, so it must be
+ * called before any other thread is created */
+void start_snapshot_thread();
+void stop_snapshot_thread();
+
 /*
 It represents standalone MySQL server or MySQL node in cluster (PXC) setup
 */
@@ -64,6 +75,10 @@ public:
   void end_node();
   void setAllParams(struct workerParams *Params) { myParams = *Params; }
   int startWork();
+  /* write what the worker threads are doing, for the live snapshot */
+  void writeSnapshot(std::ostream &out);
+  /* add operations by option of running and finished threads to counts */
+  void addOptionCounts(std::vector<Option_counts> &counts);
 
 private:
   // declaration for worker thread function
@@ -73,12 +88,32 @@ private:
   bool createGeneralLog();
   void readSettings(std::string);
   void writeFinalReport();
+  // monitoring threads, defined in monitor.cpp
+  MYSQL *sideConnection();
+  void startMonitors();
+  void stopMonitors();
+  void metricsThread();
+  void watchdogThread();
+  void captureStall(const std::string &file,
+                    const std::vector<std::string> &in_flight);
+  void writeMetrics(const std::string &line);
 
   std::vector<std::thread> workers;
+  std::vector<Thd1 *> thds; // running worker threads
+  std::vector<Option_counts> finished_counts; // of threads that ended
+  std::mutex thds_mutex;
   std::vector<std::string> *querylist;
   struct workerParams myParams;
   std::ofstream general_log;
+  std::vector<std::thread> monitors;
+  std::mutex monitor_mutex;
+  std::condition_variable monitor_cv;
+  bool monitor_stop;
+  std::ofstream metrics_log;
+  std::mutex metrics_log_mutex;
   std::atomic<unsigned long long> performed_queries_total;
   std::atomic<unsigned long long> failed_queries_total;
+  std::string server_version;
+  std::chrono::steady_clock::time_point start_time;
 };
 #endif
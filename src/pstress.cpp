@@ -13,9 +13,13 @@
 #include <cstring>
 
 #include "common.hpp"
+#include "keys.hpp"
 #include "node.hpp"
 #include "pstress.hpp"
 #include "random_test.hpp"
+#include "schedule.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
 #include <INIReader.hpp>
 #include <mysql.h>
 #include <thread>
@@ -135,6 +139,62 @@ int main(int argc, char *argv[]) {
       }
     }
   } // while
+  stats_save_requested_options();
+
+  if (options->at(Option::TRACE_EVENTS)->getInt() <= 0) {
+    std::cout << "Invalid --trace-events, use a number above 0" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  auto pk_order = options->at(Option::LOAD_PK_ORDER)->getString();
+  if (pk_order != "asc" && pk_order != "random") {
+    std::cout << "Invalid --load-pk-order " << pk_order
+              << ", use asc or random" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (options->at(Option::TARGET_QPS)->getInt() < 0) {
+    std::cout << "Invalid --target-qps, use 0 for closed loop or a rate above 0"
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  auto arrival = options->at(Option::ARRIVAL)->getString();
+  if (arrival != "uniform" && arrival != "poisson") {
+    std::cout << "Invalid --arrival " << arrival << ", use uniform or poisson"
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  auto affinity = options->at(Option::TABLE_AFFINITY)->getString();
+  if (affinity != "shared" && affinity != "disjoint" &&
+      affinity != "overlap") {
+    std::cout << "Invalid --table-affinity " << affinity
+              << ", use shared, disjoint or overlap" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (options->at(Option::AFFINITY_OVERLAP)->getInt() < 0 ||
+      options->at(Option::AFFINITY_OVERLAP)->getInt() > 100) {
+    std::cout << "Invalid --affinity-overlap, use 0 to 100" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  Key_distribution key_dist;
+  std::map<std::string, Key_distribution> table_key_dist;
+  if (!key_dist.parse(options->at(Option::KEY_DIST)->getString()) ||
+      !key_dist_parse_tables(options->at(Option::TABLE_KEY_DIST)->getString(),
+                             table_key_dist)) {
+    std::cout << "Invalid --key-dist or --table-key-dist, use uniform, "
+                 "zipf[:theta], hotspot[:h[:a]] or latest[:theta]"
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (options->at(Option::KEY_HIT_RATIO)->getInt() < 0 ||
+      options->at(Option::KEY_HIT_RATIO)->getInt() > 100) {
+    std::cout << "Invalid --key-hit-ratio, use 0 to 100" << std::endl;
+    exit(EXIT_FAILURE);
+  }
 
   /* check if user has asked for help */
   if (options->at(Option::HELP)->getBool() == true) {
@@ -152,6 +212,9 @@ int main(int argc, char *argv[]) {
     std::cout << "runnng as pquery" << std::endl;
   }
 
+  schedule_load();
+  start_snapshot_thread();
+
   auto confFile = options->at(Option::CONFIGFILE)->getString();
   if (confFile.empty()) {
     /*single node and command line */
@@ -180,11 +243,28 @@ int main(int argc, char *argv[]) {
       node->join();
   }
 
+  stop_snapshot_thread();
   save_metadata_to_file();
+  trace_dump(options->at(Option::LOGDIR)->getString() + "/step_" +
+             std::to_string(options->at(Option::STEP)->getInt()) +
+             "_trace.json");
+
+  int exit_code = EXIT_SUCCESS;
+  stats_write_summary(options->at(Option::LOGDIR)->getString() + "/step_" +
+                      std::to_string(options->at(Option::STEP)->getInt()) +
+                      "_summary.json");
+  auto baseline = options->at(Option::COMPARE_BASELINE)->getString();
+  if (!baseline.empty()) {
+    auto regressions = stats_compare_baseline(baseline);
+    if (regressions < 0)
+      exit_code = EXIT_FAILURE;
+    else if (regressions > 0)
+      exit_code = 3;
+  }
   clean_up_at_end();
   mysql_library_end();
   delete_options();
   std::cout << "COMPLETED" << std::endl;
 
-  return EXIT_SUCCESS;
+  return exit_code;
 }
@@ -4,16 +4,25 @@
  =========================================================
 */
 #include "random_test.hpp"
+#include "schedule.hpp"
+#include "scheduler.hpp"
 #include "common.hpp"
 #include "node.hpp"
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <iomanip>
 #include <regex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <libgen.h>
 
 #define CR_SERVER_GONE_ERROR 2006
 #define CR_SERVER_LOST 2013
+#define CR_LOAD_DATA_LOCAL_INFILE_REJECTED 2068
+#define ER_NOT_ALLOWED_COMMAND 1148
+#define ER_CLIENT_LOCAL_FILES_DISABLED 3948
 using namespace rapidjson;
 std::mt19937 rng;
 
@@ -29,6 +38,18 @@ const int version = 2;
 todo allow this option to be configured by user */
 const int g_integer_range = 100;
 
+/* values of INT columns and primary keys are picked in [0, key_domain()] */
+static int64_t key_domain() {
+  return static_cast<int64_t>(g_integer_range) *
+         options->at(Option::INITIAL_RECORDS_IN_TABLE)->getInt();
+}
+
+/* type of primary key and of columns compared with it, BIGINT if the key
+ * domain does not fit in INT */
+static Column::COLUMN_TYPES key_column_type() {
+  return key_domain() > INT32_MAX ? Column::BIGINT : Column::INT;
+}
+
 static bool encrypted_temp_tables = false;
 static bool encrypted_sys_tablelspaces = false;
 static bool keyring_comp_status = false;
@@ -43,16 +64,67 @@ static std::vector<std::string> algorithms;
 static std::vector<int> g_key_block_size;
 static int g_max_columns_length = 30;
 static int g_innodb_page_size;
-static int sum_of_all_opts = 0; // sum of all probablility
 std::mutex ddl_logs_write;
 static std::chrono::system_clock::time_point start_time =
     std::chrono::system_clock::now();
 
-std::atomic<int> table_started(0);
+static std::mutex phase_mutex;
+static std::condition_variable phase_cv;
+/* scheduler of startup tasks, its idle threads wait on their own condition
+ * variable and are woken by phase_changed() too */
+static Task_scheduler *phase_tasks = nullptr;
+
+void phase_changed() {
+  std::lock_guard<std::mutex> lock(phase_mutex);
+  phase_cv.notify_all();
+  if (phase_tasks != nullptr)
+    phase_tasks->wake_all();
+}
+
+static void wake_on_phase_changed(Task_scheduler *tasks) {
+  std::lock_guard<std::mutex> lock(phase_mutex);
+  phase_tasks = tasks;
+}
+
+/* set when a thread fails, waiting threads are woken to exit */
+struct Failure_flag {
+  Failure_flag &operator=(bool failed) {
+    flag = failed;
+    phase_changed();
+    return *this;
+  }
+  operator bool() const { return flag; }
+  std::atomic<bool> flag{false};
+};
+
 std::atomic<size_t> check_failures(0);
 std::atomic<size_t> table_completed(0);
 std::atomic_flag lock_stream = ATOMIC_FLAG_INIT;
-std::atomic<bool> run_query_failed(false);
+Failure_flag run_query_failed;
+
+bool wait_for_phase(Thd1 *thd, const std::function<bool()> &done,
+                    const char *phase) {
+  std::unique_lock<std::mutex> lock(phase_mutex);
+  while (!done()) {
+    if (run_query_failed) {
+      thd->thread_log << "Some other thread failed, Exiting. Please check logs "
+                      << std::endl;
+      return false;
+    }
+    /* timeout is only to log that thread is still waiting */
+    if (phase_cv.wait_for(lock, std::chrono::seconds(10)) ==
+        std::cv_status::timeout)
+      thd->thread_log << "Waiting for all threads to finish " << phase
+                      << std::endl;
+  }
+  return true;
+}
+/* tables loaded or checked of all tables, for the live snapshot */
+void load_progress(size_t &done, size_t &total) {
+  done = std::min<size_t>(table_completed, all_tables->size());
+  total = all_tables->size();
+}
+
 /* partition type supported by system */
 std::vector<Partition::PART_TYPE> Partition::supported;
 const int maximum_records_in_each_parititon_list = 100;
@@ -65,23 +137,6 @@ static MYSQL_ROW mysql_fetch_row_safe(Thd1 *thd) {
   return mysql_fetch_row(thd->result.get());
 }
 
-/* return table pointer of matching table. This is only done during the
- * first step or during the prepare, so you would have only tables that are not
- * renamed  */
-static Table *pick_table(Table::TABLE_TYPES type, int id) {
-  std::string name = TABLE_PREFIX + std::to_string(id);
-  if (type == Table::FK) {
-    name += FK_SUFFIX;
-  } else if (type == Table::PARTITION) {
-    name += PARTITION_SUFFIX;
-  }
-  for (auto const &table : *all_tables) {
-    if (table->name_ == name)
-      return table;
-  }
-  return nullptr;
-}
-
 static bool mysql_num_fields_safe(Thd1 *thd, unsigned int req) {
   if (!thd->result) {
     thd->thread_log << "mysql_num_fields called with nullptr arg!";
@@ -96,22 +151,54 @@ static bool mysql_num_fields_safe(Thd1 *thd, unsigned int req) {
   return ret;
 }
 
-/* generate random numbers to populate in primary and fk
-@param[in] number_of_records
-@param[out] vector containing unique elements */
-static std::vector<int> generateUniqueRandomNumbers(int number_of_records) {
-
-  std::unordered_set<int> unique_keys_set(number_of_records);
+/* primary keys of initial records of a table, they are ascending for
+ * --load-pk-order=asc, else in random order
+@param[in] number_of_records */
+static Load_keys initialKeys(int64_t number_of_records) {
+  static bool ascending =
+      options->at(Option::LOAD_PK_ORDER)->getString() == "asc";
+  return Load_keys(number_of_records, key_domain(), ascending,
+                   rand_int64(INT64_MAX - 1));
+}
 
-  int max_size =
-      g_integer_range * options->at(Option::INITIAL_RECORDS_IN_TABLE)->getInt();
+/* initial records of a table loaded by one task of initial load */
+struct Load_chunk {
+  Table *table;
+  int64_t first; // first initial record of chunk
+  int64_t last;  // one past the last initial record
+};
 
-  while (unique_keys_set.size() < static_cast<size_t>(number_of_records)) {
-    unique_keys_set.insert(rand_int(max_size, 1));
+/* create table and generate primary keys of its initial records, FK child
+ * tables pick their keys from the keys of parent */
+static bool create_table(Table *table, Thd1 *thd) {
+  thd->ddl_query = true;
+  if (!execute_sql(table->definition(false), thd)) {
+    thd->thread_log << "Failed to create table " << table->name_ << std::endl;
+    run_query_failed = true;
+    return false;
   }
 
-  std::vector<int> unique_keys(unique_keys_set.begin(), unique_keys_set.end());
-  return unique_keys;
+  if (!options->at(Option::JUST_LOAD_DDL)->getBool() && table->has_pk())
+    table->load_keys = initialKeys(table->number_of_initial_records);
+
+  /* --shadow-keys are filled by the load, rows of LIST partitions can be
+   * ignored so they are read from table after the load */
+  if (table->shadow_keys &&
+      !(table->type == Table::PARTITION &&
+        static_cast<Partition *>(table)->part_type == Partition::LIST))
+    table->shadow_keys->seeding = true;
+  return true;
+}
+
+static bool load_chunk(const Load_chunk &chunk, Thd1 *thd) {
+  static const Load_keys no_keys;
+  auto table = chunk.table;
+  auto &fk_keys = table->type == Table::FK
+                      ? static_cast<FK_table *>(table)->parent->load_keys
+                      : no_keys;
+  thd->ddl_query = false;
+  return table->InsertRecords(thd, table->load_keys, fk_keys, chunk.first,
+                              chunk.last);
 }
 
 /* run check table */
@@ -172,6 +259,69 @@ static int server_version() {
   return sv;
 }
 
+/* state of redo log with --fast-load, it is changed once for all threads */
+static std::mutex fast_load_mutex;
+static enum {
+  REDO_LOG_ON,
+  REDO_LOG_DISABLED,
+  REDO_LOG_RESTORED
+} redo_log_state = REDO_LOG_ON;
+
+/* set session variables of initial load, or set them back to default before
+ * the workload. With --fast-load redo log is disabled by the first thread and
+ * enabled again by the first thread that finishes load, the others wait for
+ * it so no workload runs without redo log */
+static void set_load_session(Thd1 *thd, bool load) {
+  auto threads = options->at(Option::DDL_THREADS)->getInt();
+  auto buffer_size = options->at(Option::DDL_BUFFER_SIZE)->getInt();
+  if (threads > 0)
+    execute_sql("SET SESSION innodb_ddl_threads=" +
+                    (load ? std::to_string(threads) : "DEFAULT"),
+                thd);
+  if (buffer_size > 0)
+    execute_sql("SET SESSION innodb_ddl_buffer_size=" +
+                    (load ? std::to_string(buffer_size * 1024ULL * 1024)
+                          : "DEFAULT"),
+                thd);
+
+  if (!options->at(Option::FAST_LOAD)->getBool())
+    return;
+
+  execute_sql(load ? "SET SESSION unique_checks=0, foreign_key_checks=0"
+                   : "SET SESSION unique_checks=DEFAULT, "
+                     "foreign_key_checks=DEFAULT",
+              thd);
+
+  /* ALTER INSTANCE ... INNODB REDO_LOG is in 8.0.21 */
+  if (server_version() < 80021)
+    return;
+  std::lock_guard<std::mutex> lock(fast_load_mutex);
+  if (load && redo_log_state == REDO_LOG_ON) {
+    if (execute_sql("ALTER INSTANCE DISABLE INNODB REDO_LOG", thd)) {
+      redo_log_state = REDO_LOG_DISABLED;
+    } else {
+      std::cout << "Unable to disable redo log for --fast-load, check thread "
+                   "logs"
+                << std::endl;
+      redo_log_state = REDO_LOG_RESTORED;
+    }
+  } else if (!load && redo_log_state == REDO_LOG_DISABLED) {
+    if (!execute_sql("ALTER INSTANCE ENABLE INNODB REDO_LOG", thd))
+      std::cerr << "Unable to enable redo log after --fast-load, check thread "
+                   "logs"
+                << std::endl;
+    redo_log_state = REDO_LOG_RESTORED;
+  }
+}
+
+/* initial load settings of a thread, they are set back when it goes out of
+ * scope also if the load failed */
+struct Load_session {
+  Load_session(Thd1 *t) : thd(t) { set_load_session(thd, true); }
+  ~Load_session() { set_load_session(thd, false); }
+  Thd1 *thd;
+};
+
 /* return probabality of all options and disable some feature based on user
  * request/ branch/ fork */
 int sum_of_all_options(Thd1 *thd) {
@@ -218,6 +368,12 @@ int sum_of_all_options(Thd1 *thd) {
     opt_int_set(ALTER_REDO_LOGGING, 0);
   }
 
+  /* parallel index build settings are in 8.0.27 */
+  if (server_version() < 80027) {
+    opt_int_set(DDL_THREADS, 0);
+    opt_int_set(DDL_BUFFER_SIZE, 0);
+  }
+
   /* check if keyring component is installed */
   if (mysql_read_single_value("SELECT status_value FROM performance_schema.keyring_component_status WHERE \
       status_key='component_status'", thd) == "Active")
@@ -436,16 +592,66 @@ int sum_of_all_options(Thd1 *thd) {
   return total;
 }
 
-/* return some options */
-Option::Opt pick_some_option() {
-  int rd = rand_int(sum_of_all_opts, 1);
-  for (auto &opt : *options) {
-    if (opt == nullptr || !opt->sql)
+/* weights of sql options in a phase of the workload */
+struct Option_weights {
+  std::vector<int> weight; // by Option::Opt
+  int total = 0;
+};
+static std::vector<Option_weights> phase_weights; // by phase
+static std::vector<Option_weights> role_weights;  // by role of --roles-file
+
+/* set weights of options for every phase. A phase can change the weight of
+ * options enabled for the run, options with weight 0 or disabled for the
+ * server version stay disabled */
+static void set_phase_weights() {
+  phase_weights.clear();
+  for (auto &phase : schedule_phases()) {
+    Option_weights weights;
+    weights.weight.assign(Option::MAX, 0);
+    for (auto &opt : *options) {
+      if (opt == nullptr || !opt->sql || opt->getInt() == 0)
+        continue;
+      auto changed = phase.weights.find(opt->getOption());
+      auto weight =
+          changed == phase.weights.end() ? opt->getInt() : changed->second;
+      weights.weight[opt->getOption()] = weight;
+      weights.total += weight;
+    }
+    if (weights.total == 0)
+      throw std::runtime_error("no option selected in phase " + phase.name);
+    phase_weights.push_back(weights);
+  }
+
+  /* a role runs only the options it lists, with the same rule */
+  role_weights.clear();
+  for (auto &role : schedule_roles()) {
+    if (role.weights.empty()) {
+      role_weights.push_back(phase_weights.front());
       continue;
-    if (rd <= opt->getInt())
-      return opt->getOption();
+    }
+    Option_weights weights;
+    weights.weight.assign(Option::MAX, 0);
+    for (auto &changed : role.weights) {
+      if (options->at(changed.first)->getInt() == 0)
+        continue;
+      weights.weight[changed.first] = changed.second;
+      weights.total += changed.second;
+    }
+    if (weights.total == 0)
+      throw std::runtime_error("no option selected in role " + role.name);
+    role_weights.push_back(weights);
+  }
+}
+
+/* return some options */
+Option::Opt pick_some_option(int phase, int role) {
+  auto &weights = role >= 0 ? role_weights.at(role) : phase_weights.at(phase);
+  int rd = rand_int(weights.total, 1);
+  for (size_t i = 0; i < weights.weight.size(); i++) {
+    if (rd <= weights.weight[i])
+      return static_cast<Option::Opt>(i);
     else
-      rd -= opt->getInt();
+      rd -= weights.weight[i];
   }
   return Option::MAX;
 }
@@ -551,6 +757,13 @@ int rand_int(int upper, int lower) {
   return dist(rng);
 }
 
+/* return random 64 bit integer in the range [lower, upper] */
+int64_t rand_int64(int64_t upper, int64_t lower) {
+  assert(upper >= lower);
+  std::uniform_int_distribution<int64_t> dist(lower, upper);
+  return dist(rng);
+}
+
 /* return random float number in the range of upper and lower */
 std::string rand_float(float upper, float lower) {
   assert(upper >= lower);
@@ -592,6 +805,8 @@ Column::COLUMN_TYPES Column::col_type(std::string type) {
     return INTEGER;
   else if (type.compare("INT") == 0)
     return INT;
+  else if (type.compare("BIGINT") == 0)
+    return BIGINT;
   else if (type.compare("CHAR") == 0)
     return CHAR;
   else if (type.compare("VARCHAR") == 0)
@@ -618,6 +833,8 @@ const std::string Column::col_type_to_string(COLUMN_TYPES type) {
     return "INTEGER";
   case INT:
     return "INT";
+  case BIGINT:
+    return "BIGINT";
   case CHAR:
     return "CHAR";
   case DOUBLE:
@@ -650,8 +867,10 @@ static std::string rand_value_universal(Column::COLUMN_TYPES type_,
     break;
   case (Column::COLUMN_TYPES::INT):
     return std::to_string(
-        rand_int(g_integer_range *
-                 options->at(Option::INITIAL_RECORDS_IN_TABLE)->getInt()));
+        rand_int64(std::min<int64_t>(key_domain(), INT32_MAX)));
+    break;
+  case (Column::COLUMN_TYPES::BIGINT):
+    return std::to_string(rand_int64(key_domain()));
     break;
   case (Column::COLUMN_TYPES::FLOAT): {
     return rand_float(options->at(Option::INITIAL_RECORDS_IN_TABLE)->getInt());
@@ -735,6 +954,7 @@ Column::Column(std::string name, Table *table, COLUMN_TYPES type)
     length = rand_int(g_max_columns_length, 10);
     break;
   case INT:
+  case BIGINT:
   case INTEGER:
     name_ = "i" + name;
     if (rand_int(10) == 1)
@@ -837,14 +1057,19 @@ Generated_Column::Generated_Column(std::string name, Table *table)
   }
 
   if (g_type == INT || g_type == INTEGER) {
+    /* sum of BIGINT keys does not fit in INT */
+    for (auto pos : col_pos) {
+      if (table->columns_->at(pos)->type_ == BIGINT)
+        g_type = BIGINT;
+    }
     str = " " + col_type_to_string(g_type) + " GENERATED ALWAYS AS (";
     for (auto pos : col_pos) {
       auto col = table->columns_->at(pos);
       if (col->type_ == VARCHAR || col->type_ == CHAR || col->type_ == BLOB)
         str += " LENGTH(" + col->name_ + ")+";
-      else if (col->type_ == INT || col->type_ == INTEGER ||
-               col->type_ == BOOL || col->type_ == FLOAT ||
-               col->type_ == DOUBLE)
+      else if (col->type_ == INT || col->type_ == BIGINT ||
+               col->type_ == INTEGER || col->type_ == BOOL ||
+               col->type_ == FLOAT || col->type_ == DOUBLE)
         str += " " + col->name_ + "+";
       else
         throw std::runtime_error("unhandled " + col_type_to_string(col->type_) +
@@ -865,6 +1090,9 @@ Generated_Column::Generated_Column(std::string name, Table *table)
       case INTEGER:
         column_size = 10; // interger max string size is 10
         break;
+      case BIGINT:
+        column_size = 20;
+        break;
       case FLOAT:
       case DOUBLE:
         column_size = 10;
@@ -998,7 +1226,7 @@ template <typename Writer> void Table::Serialize(Writer &writer) const {
         writer.StartArray();
         writer.String(par.name.c_str(),
                       static_cast<SizeType>(par.name.length()));
-        writer.Int(par.range);
+        writer.Int64(par.range);
         writer.EndArray();
       }
       writer.EndArray();
@@ -1117,6 +1345,7 @@ std::string Index::definition() {
 }
 
 bool Table::load(Thd1 *thd) {
+  Trace_span span("Table::load", "load");
   thd->ddl_query = true;
   if (!execute_sql(definition(false), thd)) {
     thd->thread_log << "Failed to create table " << name_ << std::endl;
@@ -1132,16 +1361,8 @@ bool Table::load(Thd1 *thd) {
       return false;
   }
 
-  thd->ddl_query = true;
-  if (!load_secondary_indexes(thd)) {
+  if (!load_indexes(thd))
     return false;
-  }
-
-  if (this->type == Table::TABLE_TYPES::FK) {
-    if (!static_cast<FK_table *>(this)->load_fk_constraint(thd)) {
-      return false;
-    }
-  }
 
   if (run_query_failed) {
     thd->thread_log << "some other thread failed, Exiting. Please check logs "
@@ -1157,27 +1378,60 @@ Table::Table(std::string n) : name_(n), indexes_() {
   indexes_ = new std::vector<Index *>;
 }
 
-bool Table::load_secondary_indexes(Thd1 *thd) {
+/* add secondary indexes and foreign key after initial records are inserted,
+ * the time is reported as index_seconds of the table */
+bool Table::load_indexes(Thd1 *thd) {
+  auto begin = std::chrono::steady_clock::now();
+  thd->ddl_query = true;
+  /* with --fast-load foreign_key_checks is off, so foreign key can be added
+   * in place together with the indexes */
+  bool fk_with_indexes = type == Table::TABLE_TYPES::FK &&
+                         options->at(Option::FAST_LOAD)->getBool();
+  if (!load_secondary_indexes(
+          thd, fk_with_indexes
+                   ? static_cast<FK_table *>(this)->fk_constraint_clause()
+                   : ""))
+    return false;
 
-  if (indexes_->size() == 0)
-    return true;
+  if (type == Table::TABLE_TYPES::FK && !fk_with_indexes &&
+      !static_cast<FK_table *>(this)->load_fk_constraint(thd))
+    return false;
 
+  thd->stats.table_loads[name_].index_seconds +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - begin)
+          .count();
+  return true;
+}
+
+/* add all secondary indexes and the extra clause in one ALTER, so table is
+ * scanned once */
+bool Table::load_secondary_indexes(Thd1 *thd, const std::string &extra) {
+  Trace_span span("Table::load_secondary_indexes", "load");
+
+  std::string sql = "ALTER TABLE " + name_;
+  bool has_index = false;
   for (auto id : *indexes_) {
     if (id == indexes_->at(auto_inc_index))
       continue;
-    std::string sql = "ALTER TABLE " + name_ + " ADD " + id->definition();
-    if (!execute_sql(sql, thd)) {
-      thd->thread_log << "Failed to add index " << id->name_ << " on " << name_
-                      << std::endl;
-      run_query_failed = true;
-      return false;
-    }
+    sql += std::string(has_index ? ", " : " ") + "ADD " + id->definition();
+    has_index = true;
+  }
+  if (!extra.empty()) {
+    sql += std::string(has_index ? ", " : " ") + extra;
+    has_index = true;
+  }
+
+  if (has_index && !execute_sql(sql, thd)) {
+    thd->thread_log << "Failed to add indexes on " << name_ << std::endl;
+    run_query_failed = true;
+    return false;
   }
 
   return true;
 }
 
-bool FK_table::load_fk_constraint(Thd1 *thd) {
+/* clause that adds the foreign key of table */
+std::string FK_table::fk_constraint_clause() {
 
   std::string constraint = name_ + "_" + parent->name_;
   std::string pk;
@@ -1189,11 +1443,17 @@ bool FK_table::load_fk_constraint(Thd1 *thd) {
   }
   assert(pk.size() > 0);
 
-  std::string sql = "ALTER TABLE " + name_ + " ADD CONSTRAINT " + constraint +
-                    " FOREIGN KEY (ifk_col) REFERENCES " + parent->name_ +
-                    " (" + pk + ")";
-  sql += " ON UPDATE " + enumToString(on_update);
-  sql += " ON DELETE  " + enumToString(on_delete);
+  std::string clause = "ADD CONSTRAINT " + constraint +
+                       " FOREIGN KEY (ifk_col) REFERENCES " + parent->name_ +
+                       " (" + pk + ")";
+  clause += " ON UPDATE " + enumToString(on_update);
+  clause += " ON DELETE  " + enumToString(on_delete);
+  return clause;
+}
+
+bool FK_table::load_fk_constraint(Thd1 *thd) {
+
+  std::string sql = "ALTER TABLE " + name_ + " " + fk_constraint_clause();
 
   if (!execute_sql(sql, thd)) {
     thd->thread_log << "Failed to add fk constraint "
@@ -1219,11 +1479,8 @@ Partition::Partition(std::string n) : Table(n) {
 
   /* randomly pick ranges for partition */
   if (part_type == RANGE) {
-    auto number_of_records =
-        options->at(Option::INITIAL_RECORDS_IN_TABLE)->getInt();
     for (int i = 0; i < number_of_part; i++) {
-      positions.emplace_back("p",
-                             rand_int(g_integer_range * number_of_records));
+      positions.emplace_back("p", rand_int64(key_domain()));
     }
     std::sort(positions.begin(), positions.end(), Partition::compareRange);
     for (int i = 0; i < number_of_part; i++) {
@@ -1263,7 +1520,8 @@ Partition::Partition(std::string n) : Table(n) {
 }
 
 void Table::DropCreate(Thd1 *thd) {
-  execute_sql("DROP TABLE " + name_, thd);
+  if (execute_sql("DROP TABLE " + name_, thd) && shadow_keys)
+    shadow_keys->clear();
   std::string def = definition();
   if (!execute_sql(def, thd) && tablespace.size() > 0) {
     std::string tbs = " TABLESPACE=" + tablespace + "_rename";
@@ -1347,8 +1605,8 @@ void Table::Truncate(Thd1 *thd) {
     execute_sql("ALTER TABLE " + name_ + pick_algorithm_lock() +
                     ", TRUNCATE PARTITION " + part_name,
                 thd);
-  } else {
-    execute_sql("TRUNCATE TABLE " + name_, thd);
+  } else if (execute_sql("TRUNCATE TABLE " + name_, thd) && shadow_keys) {
+    shadow_keys->clear();
   }
 }
 
@@ -1404,8 +1662,8 @@ void Partition::AddDrop(Thd1 *thd) {
     } else {
       /* add partition */
       table_mutex.lock();
-      int first;
-      int second;
+      int64_t first;
+      int64_t second;
       std::string par_name;
       if (positions.size()) {
         if (positions.size() > 1) {
@@ -1417,12 +1675,12 @@ void Partition::AddDrop(Thd1 *thd) {
           }
           auto par = positions.at(pst);
           auto prev_par = positions.at(pst - 1);
-          first = rand_int(par.range, prev_par.range);
+          first = rand_int64(par.range, prev_par.range);
           second = par.range;
           par_name = par.name;
         } else {
           auto par = positions.at(0);
-          first = rand_int(par.range);
+          first = rand_int64(par.range);
           second = par.range;
           par_name = par.name;
         }
@@ -1547,7 +1805,9 @@ void Table::CreateDefaultColumn() {
 
   if (type == FK) {
     std::string name = "fk_col";
-    Column::COLUMN_TYPES type = Column::INTEGER;
+    Column::COLUMN_TYPES type = key_column_type() == Column::BIGINT
+                                    ? Column::BIGINT
+                                    : Column::INTEGER;
     AddInternalColumn(new Column{name, this, type});
   }
 
@@ -1558,7 +1818,7 @@ void Table::CreateDefaultColumn() {
     if (static_cast<Partition *>(this)->part_type == Partition::LIST)
       type = Column::INTEGER;
     else
-      type = Column::INT;
+      type = key_column_type();
     auto col = new Column{name, this, type};
     AddInternalColumn(col);
   }
@@ -1576,7 +1836,7 @@ void Table::CreateDefaultColumn() {
 
     /* First column can be primary */
     if (i == 0 && rand_int(100) <= options->at(Option::PRIMARY_KEY)->getInt()) {
-      type = Column::INT;
+      type = key_column_type();
       name = "pkey";
       col = new Column{name, this, type};
       col->primary_key = true;
@@ -2010,6 +2270,91 @@ void generate_metadata_for_tables() {
   }
 }
 
+/* single integer value of a query run for --server-timing-sample, it is not
+ * counted or logged */
+static bool fetch_timing_value(Thd1 *thd, const std::string &sql,
+                               long long &value) {
+  if (mysql_real_query(thd->conn, sql.c_str(), sql.size()) != 0)
+    return false;
+  MYSQL_RES *result = mysql_store_result(thd->conn);
+  if (result == nullptr)
+    return false;
+  MYSQL_ROW row = mysql_fetch_row(result);
+  bool found = row != nullptr && row[0] != nullptr;
+  if (found)
+    value = std::strtoll(row[0], nullptr, 10);
+  mysql_free_result(result);
+  return found;
+}
+
+void server_timing_connect(Thd1 *thd) {
+  if (options->at(Option::SERVER_TIMING_SAMPLE)->getInt() <= 0)
+    return;
+  if (!fetch_timing_value(thd,
+                          "SELECT THREAD_ID FROM performance_schema.threads "
+                          "WHERE PROCESSLIST_ID = CONNECTION_ID()",
+                          thd->ps_thread_id)) {
+    thd->ps_thread_id = -1;
+    thd->thread_log << "server timing is not available, "
+                       "performance_schema is disabled"
+                    << std::endl;
+  }
+}
+
+/* read the server execution time of the last query of the thread from
+ * performance_schema and compare it with the time measured by the client. It
+ * runs between operations, so it is not in their latency */
+static void sample_server_timing(Thd1 *thd) {
+  thd->server_timing_pending = false;
+
+  /* history of the connection, latest row is the last statement of the thread
+   * as the running one is only in events_statements_current */
+  long long timer_wait;
+  if (!fetch_timing_value(thd,
+                          "SELECT TIMER_WAIT FROM "
+                          "performance_schema.events_statements_history "
+                          "WHERE THREAD_ID = " +
+                              std::to_string(thd->ps_thread_id) +
+                              " ORDER BY EVENT_ID DESC LIMIT 1",
+                          timer_wait))
+    return;
+
+  /* TIMER_WAIT is in pico-seconds */
+  long long server_us = timer_wait / 1000000;
+  thd->stats.server.add(server_us);
+  thd->stats.overhead.add(thd->sampled_client_us > server_us
+                              ? thd->sampled_client_us - server_us
+                              : 0);
+}
+
+/* single writer, so a relaxed load and store is enough and has no locked
+ * instruction */
+void Thd1::count_option(int option, bool success, unsigned long long us) {
+  auto &counters = option_counters[option];
+  auto add = [](auto &counter, unsigned long long value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+  };
+  add(counters.total, 1);
+  if (success)
+    add(counters.success, 1);
+  add(counters.us, us);
+}
+
+Option_counts Thd1::option_counts(int option) const {
+  auto &counters = option_counters[option];
+  Option_counts counts;
+  counts.total = counters.total.load(std::memory_order_relaxed);
+  counts.success = counters.success.load(std::memory_order_relaxed);
+  counts.us = counters.us.load(std::memory_order_relaxed);
+  return counts;
+}
+
+void Thd1::set_in_flight(const std::string *sql) {
+  std::lock_guard<std::mutex> lock(in_flight_mutex);
+  in_flight_sql = sql;
+}
+
 bool execute_sql(const std::string &sql, Thd1 *thd) {
   auto query = sql.c_str();
   static auto log_all = opt_bool(LOG_ALL_QUERIES);
@@ -2018,13 +2363,37 @@ bool execute_sql(const std::string &sql, Thd1 *thd) {
   static auto log_query_duration = opt_bool(LOG_QUERY_DURATION);
   static auto log_client_output = opt_bool(LOG_CLIENT_OUTPUT);
   static auto log_query_numbers = opt_bool(LOG_QUERY_NUMBERS);
+  static auto watchdog = options->at(Option::STALL_THRESHOLD)->getInt() > 0;
+  static auto server_timing_sample =
+      options->at(Option::SERVER_TIMING_SAMPLE)->getInt();
   std::chrono::system_clock::time_point begin, end;
 
   if (log_query_duration) {
     begin = std::chrono::system_clock::now();
   }
 
-  auto res = mysql_real_query(thd->conn, query, strlen(query));
+  /* phases of the query, sending and execution ends with mysql_real_query,
+   * fetch with mysql_store_result and the rest is client output and logging */
+  auto query_begin = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point query_end, fetch_end;
+
+  thd->query_start.store(std::chrono::duration_cast<std::chrono::milliseconds>(
+                             query_begin.time_since_epoch())
+                             .count(),
+                         std::memory_order_relaxed);
+  if (watchdog)
+    thd->set_in_flight(&sql);
+
+  int res;
+  {
+    Trace_span span("mysql_real_query", "server");
+    res = mysql_real_query(thd->conn, query, strlen(query));
+  }
+  query_end = fetch_end = std::chrono::steady_clock::now();
+
+  if (watchdog)
+    thd->set_in_flight(nullptr);
+  thd->query_start.store(0, std::memory_order_relaxed);
 
   if (log_query_duration) {
     end = std::chrono::system_clock::now();
@@ -2045,9 +2414,11 @@ bool execute_sql(const std::string &sql, Thd1 *thd) {
   thd->performed_queries_total++;
 
   if (res != 0) { // query failed
+    thd->stats.errors[mysql_errno(thd->conn)]++;
     thd->failed_queries_total++;
     thd->max_con_fail_count++;
     if (log_all || log_failed) {
+      Trace_span span("log_query", "log");
       thd->thread_log << " F " << sql << std::endl;
       thd->thread_log << "Error " << mysql_error(thd->conn) << std::endl;
     }
@@ -2059,13 +2430,19 @@ bool execute_sql(const std::string &sql, Thd1 *thd) {
   } else {
     thd->max_con_fail_count = 0;
     thd->success = true;
-    auto result = mysql_store_result(thd->conn);
+    MYSQL_RES *result;
+    {
+      Trace_span span("mysql_store_result", "fetch");
+      result = mysql_store_result(thd->conn);
+    }
+    fetch_end = std::chrono::steady_clock::now();
     thd->result = std::shared_ptr<MYSQL_RES>(result, [](MYSQL_RES *r) {
       if (r)
         mysql_free_result(r);
     });
 
     if (log_client_output) {
+      Trace_span span("client_output", "log");
       if (thd->result != nullptr) {
         unsigned int i, num_fields;
 
@@ -2094,6 +2471,7 @@ bool execute_sql(const std::string &sql, Thd1 *thd) {
 
     /* log successful query */
     if (log_all || log_success) {
+      Trace_span span("log_query", "log");
       thd->thread_log << " S " << sql;
       int number;
       if (thd->result == nullptr)
@@ -2104,13 +2482,51 @@ bool execute_sql(const std::string &sql, Thd1 *thd) {
     }
   }
 
+  /* time of the shape is from sending the query to having the result */
+  auto client_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                       fetch_end - query_begin)
+                       .count();
+  if (thd->shape.option >= 0 && !thd->warmup) {
+    auto &stats = thd->stats.shapes[thd->shape.key()];
+    stats.total++;
+    if (res == 0)
+      stats.success++;
+    stats.latency.add(client_us);
+  }
+
   if (thd->ddl_query) {
+    Trace_span span("ddl_log", "log");
     ddl_logs_write.lock();
     thd->ddl_logs << thd->thread_id << " " << sql << " "
                   << mysql_error(thd->conn) << std::endl;
     ddl_logs_write.unlock();
   }
 
+  /* latency of warm-up phases is not in the statistics of the run */
+  if (thd->warmup)
+    return (res == 0 ? 1 : 0);
+
+  thd->stats.send_execute.add(
+      std::chrono::duration_cast<std::chrono::microseconds>(query_end -
+                                                            query_begin)
+          .count());
+  if (res == 0)
+    thd->stats.fetch.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                             fetch_end - query_end)
+                             .count());
+  thd->stats.client.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - fetch_end)
+                            .count());
+
+  /* the sample is the last query before the end of the operation */
+  if (server_timing_sample > 0 && thd->ps_thread_id > 0) {
+    thd->sampled_client_us = client_us;
+    if (++thd->queries_since_sample >= server_timing_sample) {
+      thd->queries_since_sample = 0;
+      thd->server_timing_pending = true;
+    }
+  }
+
   return (res == 0 ? 1 : 0);
 }
 
@@ -2164,6 +2580,7 @@ void Table::ModifyColumn(Thd1 *thd) {
     case Column::FLOAT:
     case Column::DOUBLE:
     case Column::INT:
+    case Column::BIGINT:
     case Column::INTEGER:
       col = col1;
       length = col->length;
@@ -2467,6 +2884,7 @@ void Table::DeleteAllRows(Thd1 *thd) {
   std::string sql = "DELETE FROM " + name_;
   if (type == PARTITION && rand_int(100) < 98) {
     sql += " PARTITION (";
+    thd->shape.partition_clause = Statement_shape::ONE_PARTITION;
     auto part = static_cast<Partition *>(this);
     assert(part->number_of_part > 0);
     table_mutex.lock();
@@ -2474,57 +2892,72 @@ void Table::DeleteAllRows(Thd1 *thd) {
       sql += part->positions.at(rand_int(part->positions.size() - 1)).name;
       /* below randomness is added intentionally */
       for (int i = 0; i < rand_int(part->positions.size()); i++) {
-        if (rand_int(5) == 1)
+        if (rand_int(5) == 1) {
+          thd->shape.partition_clause = Statement_shape::PARTITIONS;
           sql += "," +
                  part->positions.at(rand_int(part->positions.size() - 1)).name;
+        }
       }
     } else if (part->part_type == Partition::KEY ||
                part->part_type == Partition::HASH) {
       sql += "p" + std::to_string(rand_int(part->number_of_part - 1));
       for (int i = 0; i < rand_int(part->number_of_part); i++) {
-        if (rand_int(2) == 1)
+        if (rand_int(2) == 1) {
+          thd->shape.partition_clause = Statement_shape::PARTITIONS;
           sql += ", p" + std::to_string(rand_int(part->number_of_part - 1));
+        }
       }
     } else if (part->part_type == Partition::LIST) {
       sql += part->lists.at(rand_int(part->lists.size() - 1)).name;
       /* below randomness is added intentionally */
       for (int i = 0; i < rand_int(part->lists.size()); i++) {
-        if (rand_int(5) == 1)
+        if (rand_int(5) == 1) {
+          thd->shape.partition_clause = Statement_shape::PARTITIONS;
           sql += "," + part->lists.at(rand_int(part->lists.size() - 1)).name;
+        }
       }
     }
     table_mutex.unlock();
     sql += ")";
   }
-  execute_sql(sql, thd);
+  if (execute_sql(sql, thd) && shadow_keys &&
+      thd->shape.partition_clause == Statement_shape::NO_PARTITION_CLAUSE)
+    shadow_keys->clear();
 }
 
 void Table::SelectAllRow(Thd1 *thd) {
   std::string sql = "SELECT * FROM " + name_;
   if (type == PARTITION && rand_int(100) < 98) {
     sql += " PARTITION (";
+    thd->shape.partition_clause = Statement_shape::ONE_PARTITION;
     auto part = static_cast<Partition *>(this);
     assert(part->number_of_part > 0);
     table_mutex.lock();
     if (part->part_type == Partition::RANGE) {
       sql += part->positions.at(rand_int(part->positions.size() - 1)).name;
       for (int i = 0; i < rand_int(part->positions.size()); i++) {
-        if (rand_int(2) == 1)
+        if (rand_int(2) == 1) {
+          thd->shape.partition_clause = Statement_shape::PARTITIONS;
           sql += "," +
                  part->positions.at(rand_int(part->positions.size() - 1)).name;
+        }
       }
     } else if (part->part_type == Partition::KEY ||
                part->part_type == Partition::HASH) {
       sql += "p" + std::to_string(rand_int(part->number_of_part - 1));
       for (int i = 0; i < rand_int(part->number_of_part); i++) {
-        if (rand_int(2) == 1)
+        if (rand_int(2) == 1) {
+          thd->shape.partition_clause = Statement_shape::PARTITIONS;
           sql += ", p" + std::to_string(rand_int(part->number_of_part - 1));
+        }
       }
     } else if (part->part_type == Partition::RANGE) {
       sql += part->lists.at(rand_int(part->lists.size() - 1)).name;
       for (int i = 0; i < rand_int(part->lists.size()); i++) {
-        if (rand_int(2) == 1)
+        if (rand_int(2) == 1) {
+          thd->shape.partition_clause = Statement_shape::PARTITIONS;
           sql += "," + part->lists.at(rand_int(part->lists.size() - 1)).name;
+        }
       }
     }
     sql += ")";
@@ -2588,6 +3021,110 @@ void Table::ColumnRename(Thd1 *thd) {
   }
 }
 
+/* --key-dist of a table, --table-key-dist overrides it for some tables */
+static const Key_distribution &key_distribution(const std::string &table) {
+  static std::map<std::string, Key_distribution> tables;
+  static Key_distribution all;
+  static std::once_flag parsed;
+  std::call_once(parsed, [] {
+    all.parse(options->at(Option::KEY_DIST)->getString());
+    key_dist_parse_tables(options->at(Option::TABLE_KEY_DIST)->getString(),
+                          tables);
+  });
+  auto dist = tables.find(table);
+  return dist == tables.end() ? all : dist->second;
+}
+
+/* largest value of an INT or BIGINT key column */
+static int64_t column_domain(const Column *col) {
+  return col->type_ == Column::INT ? std::min<int64_t>(key_domain(), INT32_MAX)
+                                   : key_domain();
+}
+
+/* value of = and IN predicates. Primary key and indexed integer columns follow
+ * --key-dist, other columns are uniform. Ranks of the distribution are spread
+ * over the key domain, latest picks recently inserted primary keys. With
+ * --shadow-keys, --key-hit-ratio percent of primary key values are moved to
+ * the next key present in the table */
+std::string Table::point_value(Column *col) {
+  static auto hit_ratio = opt_int(KEY_HIT_RATIO);
+  auto &dist = key_distribution(name_);
+  if (col->type_ != Column::INT && col->type_ != Column::BIGINT)
+    return col->rand_value();
+  auto keys = col->primary_key ? shadow_keys.get() : nullptr;
+  bool hit = keys != nullptr && keys->ready && rand_int(99) < hit_ratio;
+  if (dist.kind == Key_distribution::UNIFORM && !hit)
+    return col->rand_value();
+
+  bool indexed = col->primary_key;
+  for (auto index : *indexes_) {
+    for (auto idc : *index->columns_) {
+      if (idc->column == col)
+        indexed = true;
+    }
+  }
+  if (!indexed)
+    return col->rand_value();
+
+  int64_t key;
+  auto n = column_domain(col) + 1;
+  if (dist.kind != Key_distribution::LATEST || !col->primary_key ||
+      !recent_keys.pick(dist, rng, key))
+    key = dist.kind == Key_distribution::UNIFORM
+              ? rand_int64(n - 1)
+              : key_scatter(dist.next(n, rng), n);
+  if (hit)
+    keys->find(key, key);
+  return std::to_string(key);
+}
+
+/* --shadow-keys of a table with integer primary key */
+static void init_shadow_keys(Table *table) {
+  if (!options->at(Option::SHADOW_KEYS)->getBool())
+    return;
+  for (auto col : *table->columns_) {
+    if (col->primary_key &&
+        (col->type_ == Column::INT || col->type_ == Column::BIGINT))
+      table->shadow_keys.reset(new Key_set(column_domain(col) + 1));
+  }
+}
+
+/* fill --shadow-keys of tables not loaded by this run, or loaded with rows
+ * ignored by LIST partitions, from their primary key. Threads share the
+ * tables, point statements of a table use the set once it is ready */
+static void seed_shadow_keys(Thd1 *thd) {
+  for (auto table : *all_tables) {
+    auto keys = table->shadow_keys.get();
+    if (keys == nullptr || keys->seeding.exchange(true))
+      continue;
+    std::string pk;
+    table->table_mutex.lock();
+    for (auto col : *table->columns_) {
+      if (col->primary_key)
+        pk = col->name_;
+    }
+    table->table_mutex.unlock();
+    /* rows are streamed, the table may not fit in memory of the client */
+    std::string sql = "SELECT " + pk + " FROM " + table->name_;
+    if (mysql_real_query(thd->conn, sql.c_str(), sql.size()) != 0) {
+      thd->thread_log << "seed of --shadow-keys failed " << sql << " "
+                      << mysql_error(thd->conn) << std::endl;
+      continue;
+    }
+    MYSQL_RES *result = mysql_use_result(thd->conn);
+    if (result == nullptr)
+      continue;
+    while (MYSQL_ROW row = mysql_fetch_row(result)) {
+      if (row[0])
+        keys->add(std::stoll(row[0]));
+    }
+    /* an error while fetching leaves the set without some keys */
+    if (mysql_errno(thd->conn) == 0)
+      keys->ready = true;
+    mysql_free_result(result);
+  }
+}
+
 void Table::DeleteRandomRow(Thd1 *thd) {
   table_mutex.lock();
   auto where = -1;
@@ -2615,6 +3152,7 @@ void Table::DeleteRandomRow(Thd1 *thd) {
           where = col_pos;
         break;
       case Column::INT:
+      case Column::BIGINT:
       case Column::FLOAT:
       case Column::DOUBLE:
       case Column::VARCHAR:
@@ -2636,6 +3174,7 @@ void Table::DeleteRandomRow(Thd1 *thd) {
 
   if (type == PARTITION && rand_int(10) < 2) {
     sql += " PARTITION (";
+    thd->shape.partition_clause = Statement_shape::ONE_PARTITION;
     auto part = static_cast<Partition *>(this);
     assert(part->number_of_part > 0);
     if (part->part_type == Partition::RANGE) {
@@ -2650,25 +3189,40 @@ void Table::DeleteRandomRow(Thd1 *thd) {
     sql += ")";
   }
   sql += " WHERE " + columns_->at(where)->name_;
+  thd->shape.primary_key = columns_->at(where)->primary_key;
+  std::string point; // value of = predicate
 
   auto prob = rand_int(100);
-  if (prob <= 90)
-    sql += " = " + columns_->at(where)->rand_value();
-  else if (prob <= 92)
+  if (prob <= 90) {
+    thd->shape.predicate = Statement_shape::EQUAL;
+    point = point_value(columns_->at(where));
+    sql += " = " + point;
+  } else if (prob <= 92) {
+    thd->shape.predicate = Statement_shape::RANGE;
     sql += " >= " + columns_->at(where)->rand_value() + " AND " +
            columns_->at(where)->name_ +
            " <= " + columns_->at(where)->rand_value();
-  else if (prob <= 96)
-    sql += " IN (" + columns_->at(where)->rand_value() + "," +
-           columns_->at(where)->rand_value() + ")";
-  else if (prob <= 99)
+  } else if (prob <= 96) {
+    thd->shape.predicate = Statement_shape::IN;
+    sql += " IN (" + point_value(columns_->at(where)) + "," +
+           point_value(columns_->at(where)) + ")";
+  } else if (prob <= 99) {
+    thd->shape.predicate = Statement_shape::BETWEEN;
     sql += " BETWEEN " + columns_->at(where)->rand_value() + " AND " +
            columns_->at(where)->rand_value();
-  else
+  } else {
+    thd->shape.predicate = Statement_shape::LIKE;
     sql += " LIKE " + prepare_like_string(columns_->at(where)->rand_value());
+  }
 
+  auto keys = columns_->at(where)->primary_key ? shadow_keys.get() : nullptr;
   table_mutex.unlock();
-  execute_sql(sql, thd);
+
+  /* row of the key may be in a partition the statement did not touch */
+  if (execute_sql(sql, thd) && keys != nullptr && !point.empty() &&
+      thd->shape.partition_clause == Statement_shape::NO_PARTITION_CLAUSE &&
+      mysql_affected_rows(thd->conn) > 0)
+    keys->remove(std::stoll(point));
 }
 
 void Table::SelectRandomRow(Thd1 *thd) {
@@ -2682,6 +3236,7 @@ void Table::SelectRandomRow(Thd1 *thd) {
         where = col_pos;
       break;
     case Column::INT:
+    case Column::BIGINT:
     case Column::FLOAT:
     case Column::DOUBLE:
     case Column::VARCHAR:
@@ -2703,6 +3258,7 @@ void Table::SelectRandomRow(Thd1 *thd) {
   /* if it partition table randomly pick some partition */
   if (type == PARTITION && rand_int(10) < 2) {
     sql += " PARTITION (";
+    thd->shape.partition_clause = Statement_shape::ONE_PARTITION;
     auto part = static_cast<Partition *>(this);
     assert(part->number_of_part > 0);
     if (part->part_type == Partition::RANGE) {
@@ -2718,29 +3274,47 @@ void Table::SelectRandomRow(Thd1 *thd) {
   }
 
   sql += " WHERE " + columns_->at(where)->name_;
+  thd->shape.primary_key = columns_->at(where)->primary_key;
+  std::string point; // value of = predicate
   auto prob = rand_int(100);
-  if (rand_int(1000) < 2)
+  if (rand_int(1000) < 2) {
+    thd->shape.predicate = Statement_shape::NOT_BETWEEN;
     sql += " NOT BETWEEN " + columns_->at(where)->rand_value() + " AND " +
            columns_->at(where)->rand_value();
-  else if (prob <= 90)
-    sql += " = " + columns_->at(where)->rand_value();
-  else if (prob <= 92)
+  } else if (prob <= 90) {
+    thd->shape.predicate = Statement_shape::EQUAL;
+    point = point_value(columns_->at(where));
+    sql += " = " + point;
+  } else if (prob <= 92) {
+    thd->shape.predicate = Statement_shape::GREATER_EQUAL;
     sql += " >= " + columns_->at(where)->rand_value();
-  else if (prob <= 94)
+  } else if (prob <= 94) {
+    thd->shape.predicate = Statement_shape::RANGE;
     sql += " >= " + columns_->at(where)->rand_value() + " AND " +
            columns_->at(where)->name_ +
            " <= " + columns_->at(where)->rand_value();
-  else if (prob <= 96)
-    sql += " IN (" + columns_->at(where)->rand_value() + ", " +
-           columns_->at(where)->rand_value() + ")";
-  else if (prob <= 98)
+  } else if (prob <= 96) {
+    thd->shape.predicate = Statement_shape::IN;
+    sql += " IN (" + point_value(columns_->at(where)) + ", " +
+           point_value(columns_->at(where)) + ")";
+  } else if (prob <= 98) {
+    thd->shape.predicate = Statement_shape::LIKE;
     sql += " LIKE " + prepare_like_string(columns_->at(where)->rand_value());
-  else
+  } else {
+    thd->shape.predicate = Statement_shape::BETWEEN;
     sql += " BETWEEN " + columns_->at(where)->rand_value() + " AND " +
            columns_->at(where)->rand_value();
+  }
 
+  auto keys = columns_->at(where)->primary_key ? shadow_keys.get() : nullptr;
   table_mutex.unlock();
-  execute_sql(sql, thd);
+
+  /* key of --shadow-keys is not in the table any more, unless the statement
+   * only looked in some partitions */
+  if (execute_sql(sql, thd) && keys != nullptr && !point.empty() &&
+      thd->shape.partition_clause == Statement_shape::NO_PARTITION_CLAUSE &&
+      thd->result != nullptr && mysql_num_rows(thd->result.get()) == 0)
+    keys->remove(std::stoll(point));
 }
 
 /* update random row */
@@ -2762,6 +3336,7 @@ void Table::UpdateRandomROW(Thd1 *thd) {
         where = col_pos;
       break;
     case Column::INT:
+    case Column::BIGINT:
     case Column::FLOAT:
     case Column::DOUBLE:
     case Column::VARCHAR:
@@ -2782,6 +3357,7 @@ void Table::UpdateRandomROW(Thd1 *thd) {
 
   if (type == PARTITION && rand_int(10) < 2) {
     sql += " PARTITION (";
+    thd->shape.partition_clause = Statement_shape::ONE_PARTITION;
     auto part = static_cast<Partition *>(this);
     assert(part->number_of_part > 0);
     if (part->part_type == Partition::RANGE) {
@@ -2807,33 +3383,179 @@ void Table::UpdateRandomROW(Thd1 *thd) {
       break;
     }
   }
+  thd->shape.primary_key = columns_->at(where)->primary_key;
   auto prob = rand_int(100);
-  if (prob <= 90)
+  if (prob <= 90) {
+    thd->shape.predicate = Statement_shape::EQUAL;
     sql +=
-        columns_->at(where)->name_ + " = " + columns_->at(where)->rand_value();
-  else if (prob <= 92)
+        columns_->at(where)->name_ + " = " + point_value(columns_->at(where));
+  } else if (prob <= 92) {
+    thd->shape.predicate = Statement_shape::GREATER_EQUAL;
     sql += columns_->at(where)->name_ +
            " >= " + columns_->at(where)->rand_value() + " AND " +
            columns_->at(where)->name_ +
            " >= " + columns_->at(where)->rand_value();
-  else if (prob <= 94)
+  } else if (prob <= 94) {
+    thd->shape.predicate = Statement_shape::IN;
     sql += columns_->at(where)->name_ + " IN (" +
-           columns_->at(where)->rand_value() + "," +
-           columns_->at(where)->rand_value() + ")";
-  else if (prob <= 98)
+           point_value(columns_->at(where)) + "," +
+           point_value(columns_->at(where)) + ")";
+  } else if (prob <= 98) {
+    thd->shape.predicate = Statement_shape::BETWEEN;
     sql += columns_->at(where)->name_ + " BETWEEN " +
            columns_->at(where)->rand_value() + " AND " +
            columns_->at(where)->rand_value();
-  else
+  } else {
+    thd->shape.predicate = Statement_shape::LIKE;
     sql += columns_->at(where)->name_ + " LIKE " +
            prepare_like_string(columns_->at(where)->rand_value());
+  }
 
   table_mutex.unlock();
   execute_sql(sql, thd);
 }
 
+/* set once server refuses LOAD DATA LOCAL, rest of the tables use INSERT */
+static std::atomic<bool> local_infile_rejected(false);
+
+/* rows of LOAD DATA LOCAL INFILE, they are generated when the client library
+ * asks for more data so the table is never kept in memory or on disk */
+struct Infile_rows {
+  std::function<void(std::string &)> next_row;
+  int64_t rows_left;
+  std::string buffer;
+  size_t offset = 0;
+};
+
+static int infile_init(void **ptr, const char *, void *userdata) {
+  *ptr = userdata;
+  return 0;
+}
+
+static int infile_read(void *ptr, char *buf, unsigned int buf_len) {
+  auto rows = static_cast<Infile_rows *>(ptr);
+  if (rows->offset == rows->buffer.size()) {
+    rows->buffer.clear();
+    rows->offset = 0;
+    while (rows->rows_left > 0 && rows->buffer.size() < buf_len) {
+      rows->next_row(rows->buffer);
+      rows->rows_left--;
+    }
+  }
+  size_t len = std::min<size_t>(buf_len, rows->buffer.size() - rows->offset);
+  memcpy(buf, rows->buffer.data() + rows->offset, len);
+  rows->offset += len;
+  return static_cast<int>(len);
+}
+
+static void infile_end(void *) {}
+
+static int infile_error(void *, char *error_msg, unsigned int error_msg_len) {
+  snprintf(error_msg, error_msg_len, "pstress row generator failed");
+  return 2000; // CR_UNKNOWN_ERROR
+}
+
+/* load initial records with LOAD DATA LOCAL INFILE. Values follow the same
+rules as InsertBulkRecord, written as tab separated text.
+@return false if load failed, local_infile_rejected is set if server does not
+allow LOAD DATA LOCAL */
+bool Table::LoadDataInfile(Thd1 *thd, const Load_keys &pk_keys,
+                           const Load_keys &fk_unique_keys,
+                           int64_t first, int64_t last,
+                           bool is_list_partition) {
+  Trace_span span("Table::LoadDataInfile", "load");
+  std::string sql = "LOAD DATA LOCAL INFILE 'pstress_" + name_ + "' ";
+  if (is_list_partition)
+    sql += "IGNORE ";
+  sql += "INTO TABLE " + name_ +
+         " FIELDS TERMINATED BY '\\t' LINES TERMINATED BY '\\n' (";
+  /* generated columns are left out of column list to get their default */
+  for (const auto &column : *columns_) {
+    if (column->type_ != Column::COLUMN_TYPES::GENERATED)
+      sql += column->name_ + ", ";
+  }
+  sql.erase(sql.length() - 2);
+  sql += ")";
+
+  int64_t records = first;
+  Infile_rows rows;
+  rows.rows_left = last - first;
+  rows.next_row = [&](std::string &out) {
+    bool first = true;
+    for (const auto &column : *columns_) {
+      if (column->type_ == Column::COLUMN_TYPES::GENERATED)
+        continue;
+      if (!first)
+        out += '\t';
+      first = false;
+      if (column->name_.find("fk_col") != std::string::npos) {
+        out += std::to_string(
+            fk_unique_keys.at(rand_int64(fk_unique_keys.size() - 1)));
+      } else if (column->primary_key) {
+        out += std::to_string(pk_keys.at(records));
+      } else if (column->auto_increment == true) {
+        out += "\\N";
+      } else if (is_list_partition && column->name_.compare("ip_col") == 0) {
+        out += std::to_string(
+            rand_int(maximum_records_in_each_parititon_list *
+                     options->at(Option::MAX_PARTITIONS)->getInt()));
+      } else {
+        /* rand_value returns sql literals, strings are quoted and have only
+         * alphanumeric characters so no escaping is needed */
+        auto value = column->rand_value();
+        if (value.size() >= 2 && value.front() == '\'' &&
+            value.back() == '\'')
+          out.append(value, 1, value.size() - 2);
+        else if (value == "true")
+          out += '1';
+        else if (value == "false")
+          out += '0';
+        else
+          out += value;
+      }
+    }
+    out += '\n';
+    records++;
+  };
+
+  mysql_set_local_infile_handler(thd->conn, infile_init, infile_read,
+                                 infile_end, infile_error, &rows);
+  bool loaded = execute_sql(sql, thd);
+  mysql_set_local_infile_default(thd->conn);
+
+  if (!loaded) {
+    auto error = mysql_errno(thd->conn);
+    if (error == ER_NOT_ALLOWED_COMMAND ||
+        error == ER_CLIENT_LOCAL_FILES_DISABLED ||
+        error == CR_LOAD_DATA_LOCAL_INFILE_REJECTED) {
+      if (!local_infile_rejected.exchange(true)) {
+        std::cout << "LOAD DATA LOCAL is not allowed, using INSERT to load "
+                     "tables. Enable local_infile on server to use "
+                     "--load-data-infile"
+                  << std::endl;
+        thd->thread_log << "LOAD DATA LOCAL rejected with error " << error
+                        << std::endl;
+      }
+    }
+    return false;
+  }
+
+  /* LOAD DATA LOCAL turns duplicate key and data errors into warnings and
+   * skips the rows, INSERT fails on them. Only LIST partitions ignore rows */
+  auto loaded_rows = mysql_affected_rows(thd->conn);
+  auto warnings = mysql_warning_count(thd->conn);
+  if (!is_list_partition &&
+      (loaded_rows != static_cast<uint64_t>(last - first) || warnings > 0)) {
+    thd->thread_log << "LOAD DATA loaded " << loaded_rows << " of "
+                    << last - first << " rows in " << name_ << " with "
+                    << warnings << " warnings" << std::endl;
+    return false;
+  }
+  return true;
+}
+
 bool Table::InsertBulkRecord(Thd1 *thd) {
-  bool is_list_partition = false;
+  Trace_span span("Table::InsertBulkRecord", "load");
 
   // if parent has no records, child can't have records
   if (type == FK) {
@@ -2844,32 +3566,76 @@ bool Table::InsertBulkRecord(Thd1 *thd) {
   if (number_of_initial_records == 0)
     return true;
 
-  std::string prepare_sql = "INSERT ";
-
-  std::vector<int> fk_unique_keys;
+  Load_keys fk_unique_keys;
 
   /* If a table has FK move its parent keys in fk_unique_keys */
   if (type == TABLE_TYPES::FK) {
-    fk_unique_keys = std::move(thd->unique_keys);
+    fk_unique_keys = thd->unique_keys;
   }
   if (has_pk()) {
-    thd->unique_keys = generateUniqueRandomNumbers(number_of_initial_records);
+    thd->unique_keys = initialKeys(number_of_initial_records);
   }
 
+  return InsertRecords(thd, thd->unique_keys, fk_unique_keys, 0,
+                       number_of_initial_records);
+}
+
+/* insert initial records from first to last-1. pk_keys has the primary key of
+ * every initial record and fk_unique_keys the primary keys of parent table */
+bool Table::InsertRecords(Thd1 *thd, const Load_keys &pk_keys,
+                          const Load_keys &fk_unique_keys,
+                          int64_t first, int64_t last) {
+  bool is_list_partition = false;
+  auto load_begin = std::chrono::steady_clock::now();
+  /* rows and time of initial load for the run report */
+  auto record_load = [&]() {
+    auto &load = thd->stats.table_loads[name_];
+    load.rows += last - first;
+    load.seconds += std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - load_begin)
+                        .count();
+    /* newest initial records are the first keys of --key-dist=latest */
+    if (has_pk() && pk_keys.size() >= last) {
+      for (auto i = std::max<int64_t>(first, last - Recent_keys::SIZE);
+           i < last; i++)
+        recent_keys.add(pk_keys.at(i));
+      if (shadow_keys && !is_list_partition) {
+        for (auto i = first; i < last; i++)
+          shadow_keys->add(pk_keys.at(i));
+      }
+    }
+  };
+
+  std::string prepare_sql = "INSERT ";
+
   /* ignore error in the case parition list  */
   if (type == PARTITION &&
       static_cast<Partition *>(this)->part_type == Partition::LIST) {
     is_list_partition = true;
   }
 
+  if (options->at(Option::LOAD_DATA_INFILE)->getBool() &&
+      !local_infile_rejected) {
+    if (LoadDataInfile(thd, pk_keys, fk_unique_keys, first, last,
+                       is_list_partition)) {
+      record_load();
+      return true;
+    }
+    if (!local_infile_rejected) {
+      ddl_logs_write.lock();
+      thd->ddl_logs << "Load data failed for table  " << name_ << std::endl;
+      ddl_logs_write.unlock();
+      run_query_failed = true;
+      return false;
+    }
+  }
+
   if (is_list_partition)
     prepare_sql += "IGNORE ";
 
   prepare_sql += "INTO " + name_ + " (";
 
-  assert(number_of_initial_records <=
-         (g_integer_range *
-          options->at(Option::INITIAL_RECORDS_IN_TABLE)->getInt()));
+  assert(number_of_initial_records <= key_domain());
 
   for (const auto &column : *columns_) {
     prepare_sql += column->name_ + ", ";
@@ -2879,19 +3645,19 @@ bool Table::InsertBulkRecord(Thd1 *thd) {
   prepare_sql += ")";
 
   std::string values = " VALUES";
-  int records = 0;
+  int64_t records = first;
 
-  while (records < number_of_initial_records) {
+  while (records < last) {
     std::string value = "(";
     for (const auto &column : *columns_) {
       /* For FK we get the unique value from the parent table unique vector */
       if (column->name_.find("fk_col") != std::string::npos) {
-        value +=
-            std::to_string(fk_unique_keys[rand_int(fk_unique_keys.size() - 1)]);
+        value += std::to_string(
+            fk_unique_keys.at(rand_int64(fk_unique_keys.size() - 1)));
       } else if (column->type_ == Column::COLUMN_TYPES::GENERATED) {
         value += "DEFAULT";
       } else if (column->primary_key) {
-        value += std::to_string(thd->unique_keys.at(records));
+        value += std::to_string(pk_keys.at(records));
       } else if (column->auto_increment == true) {
         value += "NULL";
       } else if (is_list_partition && column->name_.compare("ip_col") == 0) {
@@ -2910,7 +3676,7 @@ bool Table::InsertBulkRecord(Thd1 *thd) {
     value += ")";
     values += value;
     records++;
-    if (values.size() > 1024 * 1024 || number_of_initial_records == records) {
+    if (values.size() > 1024 * 1024 || last == records) {
       if (!execute_sql(prepare_sql + values, thd)) {
         ddl_logs_write.lock();
         thd->ddl_logs << "Bulk insert failed for table  " << name_ << std::endl;
@@ -2924,6 +3690,7 @@ bool Table::InsertBulkRecord(Thd1 *thd) {
     }
   }
 
+  record_load();
   return true;
 }
 
@@ -2935,6 +3702,7 @@ void Table::InsertRandomRow(Thd1 *thd) {
   type = rand_int(3) == 0 ? "INSERT" : "REPLACE";
 
   std::string sql = type + " INTO " + name_ + "  ( ";
+  std::string pk_value;
   for (auto &column : *columns_) {
     sql += column->name_ + " ,";
     std::string val;
@@ -2944,6 +3712,8 @@ void Table::InsertRandomRow(Thd1 *thd) {
       val = column->rand_value();
     if (column->auto_increment == true && rand_int(100) < 10)
       val = "NULL";
+    if (column->primary_key)
+      pk_value = val;
     vals += " " + val + ",";
   }
 
@@ -2954,7 +3724,13 @@ void Table::InsertRandomRow(Thd1 *thd) {
   sql += ") VALUES(" + vals;
   sql += " )";
   table_mutex.unlock();
-  execute_sql(sql, thd);
+  if (execute_sql(sql, thd) && !pk_value.empty()) {
+    int64_t key = pk_value == "NULL" ? mysql_insert_id(thd->conn)
+                                     : std::stoll(pk_value);
+    recent_keys.add(key);
+    if (shadow_keys)
+      shadow_keys->add(key);
+  }
 }
 
 /* set mysqld_variable */
@@ -3344,7 +4120,7 @@ static std::string load_metadata_from_file() {
       if (part_type.compare("RANGE") == 0) {
         for (auto &par_range : tab["part_range"].GetArray()) {
           static_cast<Partition *>(table)->positions.emplace_back(
-              par_range[0].GetString(), par_range[1].GetInt());
+              par_range[0].GetString(), par_range[1].GetInt64());
         }
       } else if (part_type.compare("LIST") == 0) {
         int curr_index_of_list = 0;
@@ -3402,7 +4178,8 @@ static std::string load_metadata_from_file() {
       Column *a;
       std::string type = col["type"].GetString();
 
-      if (type.compare("INT") == 0 || type.compare("CHAR") == 0 ||
+      if (type.compare("INT") == 0 || type.compare("BIGINT") == 0 ||
+          type.compare("CHAR") == 0 ||
           type.compare("VARCHAR") == 0 || type.compare("BOOL") == 0 ||
           type.compare("FLOAT") == 0 || type.compare("DOUBLE") == 0 ||
           type.compare("INTEGER") == 0) {
@@ -3458,99 +4235,200 @@ void clean_up_at_end() {
   delete random_strs;
 }
 
-/* create new database and tablespace */
-void create_database_tablespace(Thd1 *thd) {
+/* create new database */
+void create_database(Thd1 *thd) {
 
   /* drop database test*/
   execute_sql("DROP DATABASE IF EXISTS test", thd);
   execute_sql("CREATE DATABASE test", thd); // todo encrypt database/schema
+}
 
-  for (auto &tab : g_tablespace) {
-    if (tab.compare("innodb_system") == 0)
-      continue;
+/* create a general tablespace, it is a task of initial load */
+static bool create_tablespace(const std::string &tab, Thd1 *thd) {
+  std::string sql =
+      "CREATE TABLESPACE " + tab + " ADD DATAFILE '" + tab + ".ibd' ";
 
-    std::string sql =
-        "CREATE TABLESPACE " + tab + " ADD DATAFILE '" + tab + ".ibd' ";
+  if (g_innodb_page_size <= INNODB_16K_PAGE_SIZE) {
+    sql += " FILE_BLOCK_SIZE " + tab.substr(3, 3);
+  }
 
-    if (g_innodb_page_size <= INNODB_16K_PAGE_SIZE) {
-      sql += " FILE_BLOCK_SIZE " + tab.substr(3, 3);
-    }
+  /* encrypt tablespace */
+  if (!options->at(Option::NO_ENCRYPTION)->getBool()) {
+    if (tab.substr(tab.size() - 2, 2).compare("_e") == 0)
+      sql += " ENCRYPTION='Y'";
+    else if (server_version() >= 80000)
+      sql += " ENCRYPTION='N'";
+  }
 
-    /* encrypt tablespace */
-    if (!options->at(Option::NO_ENCRYPTION)->getBool()) {
-      if (tab.substr(tab.size() - 2, 2).compare("_e") == 0)
-        sql += " ENCRYPTION='Y'";
-      else if (server_version() >= 80000)
-        sql += " ENCRYPTION='N'";
-    }
+  /* first try to rename tablespace back */
+  if (server_version() >= 80000)
+    execute_sql("ALTER TABLESPACE " + tab + "_rename rename to " + tab, thd);
 
-    /* first try to rename tablespace back */
-    if (server_version() >= 80000)
-      execute_sql("ALTER TABLESPACE " + tab + "_rename rename to " + tab, thd);
+  execute_sql("DROP TABLESPACE " + tab, thd);
 
-    execute_sql("DROP TABLESPACE " + tab, thd);
+  if (!execute_sql(sql, thd)) {
+    std::cerr << "Failed to create tablespace " << tab << ": "
+              << mysql_error(thd->conn) << std::endl;
+    run_query_failed = true;
+    return false;
+  }
+  return true;
+}
 
-    if (!execute_sql(sql, thd))
-      throw std::runtime_error("error in " + sql);
+/* create an undo tablespace, it is a task of initial load. Failure is only
+ * reported, workload can run without it */
+static bool create_undo_tablespace(const std::string &name, Thd1 *thd) {
+  std::string sql =
+      "CREATE UNDO TABLESPACE " + name + " ADD DATAFILE '" + name + ".ibu'";
+  if (!execute_sql(sql, thd)) {
+    ddl_logs_write.lock();
+    thd->ddl_logs << "Failed to create undo tablespace " << name << ": "
+                  << mysql_error(thd->conn) << std::endl;
+    ddl_logs_write.unlock();
   }
+  return true;
+}
 
-  if (server_version() >= 80000) {
-    for (auto &name : g_undo_tablespace) {
-      std::string sql =
-          "CREATE UNDO TABLESPACE " + name + " ADD DATAFILE '" + name + ".ibu'";
-      execute_sql(sql, thd);
-    }
+/* names of partitions of a table, empty if table is not partitioned */
+static std::vector<std::string> partition_names(Table *table) {
+  std::vector<std::string> names;
+  if (table->type != Table::PARTITION)
+    return names;
+  auto part = static_cast<Partition *>(table);
+  switch (part->part_type) {
+  case Partition::LIST:
+    for (const auto &list : part->lists)
+      names.push_back(list.name);
+    break;
+  case Partition::RANGE:
+    for (const auto &range : part->positions)
+      names.push_back(range.name);
+    break;
+  case Partition::HASH:
+  case Partition::KEY:
+    for (int i = 0; i < part->number_of_part; i++)
+      names.push_back("p" + std::to_string(i));
+    break;
   }
+  return names;
 }
 
-/* check all tables and partition in the starting and if any check table false
- * return false */
-static bool check_tables_partitions_preload(Table *table, Thd1 *thd) {
+/* check partitions [first, last) of a table in the starting
+@return number of partitions that failed the check */
+static size_t check_partitions_preload(Table *table,
+                                       const std::vector<std::string> &names,
+                                       size_t first, size_t last, Thd1 *thd) {
   size_t failures = 0;
-  if (table->type == Table::PARTITION) {
-    int partition_count;
-    switch (static_cast<Partition *>(table)->part_type) {
-    case Partition::LIST:
-      partition_count = static_cast<Partition *>(table)->lists.size();
-      for (int i = 0; i < partition_count; i++) {
-        get_check_result("ALTER TABLE " + table->name_ + " CHECK PARTITION " +
-                             static_cast<Partition *>(table)->lists[i].name,
-                         thd) ||
-            failures++;
-      }
-      break;
-    case Partition::RANGE:
-      partition_count = static_cast<Partition *>(table)->positions.size();
-      for (int i = 0; i < partition_count; i++) {
-        get_check_result("ALTER TABLE " + table->name_ + " CHECK PARTITION " +
-                             static_cast<Partition *>(table)->positions[i].name,
-                         thd) ||
-            failures++;
-      }
-      break;
-    case Partition::HASH:
-    case Partition::KEY:
-      partition_count = static_cast<Partition *>(table)->number_of_part;
-      for (int i = 0; i < partition_count; i++) {
-        get_check_result("ALTER TABLE " + table->name_ + " CHECK PARTITION p" +
-                             std::to_string(i),
-                         thd) ||
-            failures++;
-      }
-      break;
-    }
-  } else {
-    get_check_result("CHECK TABLE " + table->name_, thd) || failures++;
+  for (size_t i = first; i < last; i++) {
+    get_check_result("ALTER TABLE " + table->name_ + " CHECK PARTITION " +
+                         names[i],
+                     thd) ||
+        failures++;
   }
-  if (failures != 0) {
-    check_failures++;
+  return failures;
+}
+
+/* --reuse-dataset. After --prepare the fingerprint of metadata is saved with
+ * row count and checksum of every table, a later prepare with the same
+ * fingerprint verifies the tables and skips the load */
+static const std::string DATASET_TABLE = "test.pstress_dataset";
+static bool dataset_reused = false;
+static std::string dataset_id; // fingerprint of generated metadata
+
+/* FNV-1a hash of the metadata and of the options that change loaded rows */
+static std::string dataset_fingerprint() {
+  StringBuffer sb;
+  Writer<StringBuffer> writer(sb);
+  writer.StartObject();
+  writer.String("version");
+  writer.Uint(version);
+  writer.String("seed");
+  writer.Int(options->at(Option::INITIAL_SEED)->getInt() +
+             options->at(Option::STEP)->getInt());
+  writer.String("pk_order");
+  writer.String(options->at(Option::LOAD_PK_ORDER)->getString().c_str());
+  writer.String("tables");
+  writer.StartArray();
+  for (auto table : *all_tables)
+    table->Serialize(writer);
+  writer.EndArray();
+  /* records requested for each table, they are not part of the metadata */
+  writer.String("records");
+  writer.StartArray();
+  for (auto table : *all_tables)
+    writer.Int64(table->number_of_initial_records);
+  writer.EndArray();
+  writer.EndObject();
+
+  uint64_t hash = 14695981039346656037ULL;
+  for (const char *c = sb.GetString(); *c; c++) {
+    hash ^= static_cast<unsigned char>(*c);
+    hash *= 1099511628211ULL;
+  }
+  std::stringstream fingerprint;
+  fingerprint << std::hex << std::setw(16) << std::setfill('0') << hash;
+  return fingerprint.str();
+}
+
+/* return second column of CHECKSUM TABLE */
+static std::string table_checksum(const std::string &table, Thd1 *thd) {
+  execute_sql("CHECKSUM TABLE " + table, thd);
+  auto row = mysql_fetch_row_safe(thd);
+  if (row && mysql_num_fields_safe(thd, 2) && row[1])
+    return row[1];
+  return "";
+}
+
+/* true if tables in server were loaded from the same metadata and still have
+ * the saved row count. Checksum is compared for a sample of the tables */
+static bool dataset_matches(Thd1 *thd) {
+  if (mysql_read_single_value("SELECT COUNT(*) FROM information_schema.tables "
+                              "WHERE table_schema='test' AND "
+                              "table_name='pstress_dataset'",
+                              thd) != "1")
+    return false;
+
+  std::map<std::string, std::pair<std::string, std::string>> saved;
+  if (!execute_sql("SELECT table_name, row_count, checksum FROM " +
+                       DATASET_TABLE + " WHERE fingerprint='" + dataset_id +
+                       "'",
+                   thd) ||
+      !mysql_num_fields_safe(thd, 3))
+    return false;
+  while (auto row = mysql_fetch_row(thd->result.get()))
+    saved[row[0]] = {row[1], row[2] ? row[2] : ""};
+  if (saved.size() != all_tables->size()) {
+    thd->thread_log << "dataset has fingerprint of other metadata"
+                    << std::endl;
+    return false;
+  }
+
+  const size_t checksum_sample = 5;
+  for (size_t i = 0; i < all_tables->size(); i++) {
+    auto &name = all_tables->at(i)->name_;
+    auto table = saved.find(name);
+    if (table == saved.end() ||
+        mysql_read_single_value("SELECT COUNT(*) FROM " + name, thd) !=
+            table->second.first) {
+      thd->thread_log << "row count of " << name << " does not match dataset"
+                      << std::endl;
+      return false;
+    }
+    /* tables spread over the list */
+    if (i % std::max<size_t>(all_tables->size() / checksum_sample, 1) == 0 &&
+        table_checksum(name, thd) != table->second.second) {
+      thd->thread_log << "checksum of " << name << " does not match dataset"
+                      << std::endl;
+      return false;
+    }
   }
-  return failures == 0 ? true : false;
+  return true;
 }
 
 /* load metadata */
 bool Thd1::load_metadata() {
-  sum_of_all_opts = sum_of_all_options(this);
+  sum_of_all_options(this);
+  set_phase_weights();
 
   auto seed = opt_int(INITIAL_SEED);
   seed += options->at(Option::STEP)->getInt();
@@ -3569,21 +4447,316 @@ bool Thd1::load_metadata() {
     auto file = load_metadata_from_file();
     std::cout << "metadata loaded from " << file << std::endl;
   } else {
-    create_database_tablespace(this);
     generate_metadata_for_tables();
+    dataset_id = dataset_fingerprint();
     std::cout << "metadata created randomly" << std::endl;
+    if (options->at(Option::REUSE_DATASET)->getBool() &&
+        dataset_matches(this)) {
+      dataset_reused = true;
+      table_completed = all_tables->size();
+      std::cout << "dataset in server matches metadata, skipping load"
+                << std::endl;
+    } else {
+      create_database(this);
+    }
   }
 
+  /* workload changes the tables, so the dataset can't be reused after it */
+  if (!options->at(Option::PREPARE)->getBool())
+    execute_sql("DROP TABLE IF EXISTS " + DATASET_TABLE, this);
+
   if (options->at(Option::TABLES)->getInt() <= 0)
     throw std::runtime_error("no table to work on \n");
 
+  int64_t shadow_bytes = 0;
+  for (auto table : *all_tables) {
+    init_shadow_keys(table);
+    if (table->shadow_keys)
+      shadow_bytes += table->shadow_keys->max_bytes();
+  }
+  if (shadow_bytes > 0)
+    std::cout << "--shadow-keys uses up to " << shadow_bytes / (1024 * 1024) + 1
+              << " MB for " << all_tables->size() << " tables" << std::endl;
+
   return 1;
 }
 
+/* tasks of initial load or of check of tables, planned by the first thread
+ * and run by all threads */
+static std::once_flag startup_tasks_planned;
+static std::unique_ptr<Task_scheduler> startup_tasks;
+
+/* Plan initial load. Each tablespace is created by its own task and a table
+after its tablespace, an FK child after its parent so keys of parent exist.
+Initial records are inserted in chunks of --load-chunk-size rows, the whole
+table is one chunk if it is 0. Chunks are disjoint sets of the keys of the
+table, they are key ranges only with --load-pk-order=asc. Indexes and foreign
+key are added after all chunks of table and FK constraint after parent is
+complete */
+static void plan_load_tasks() {
+  typedef Task_scheduler::Task_id Task_id;
+  startup_tasks.reset(
+      new Task_scheduler(options->at(Option::THREADS)->getInt(),
+                         [] { return bool(run_query_failed); }));
+  wake_on_phase_changed(startup_tasks.get());
+  auto &tasks = *startup_tasks;
+  int chunk_size = options->at(Option::LOAD_CHUNK_SIZE)->getInt();
+  bool load_rows = !options->at(Option::JUST_LOAD_DDL)->getBool();
+
+  /* every tablespace is created by its own task, so files are created on
+   * many connections in parallel */
+  std::map<std::string, Task_id> tablespaces;
+  for (auto &tab : g_tablespace) {
+    if (tab.compare("innodb_system") == 0)
+      continue;
+    tablespaces[tab] = tasks.add(
+        "create_tablespace",
+        [tab](Thd1 *thd) { return create_tablespace(tab, thd); });
+  }
+  if (server_version() >= 80000) {
+    for (auto &name : g_undo_tablespace)
+      tasks.add("create_undo_tablespace", [name](Thd1 *thd) {
+        return create_undo_tablespace(name, thd);
+      });
+  }
+
+  std::map<Table *, Task_id> created, completed;
+  std::vector<Task_id> all_completed;
+  for (auto table : *all_tables) {
+    auto fk = table->type == Table::FK ? static_cast<FK_table *>(table)
+                                       : nullptr;
+    std::vector<Task_id> after_create;
+    auto tablespace = tablespaces.find(table->tablespace);
+    if (tablespace != tablespaces.end())
+      after_create.push_back(tablespace->second);
+    if (fk) {
+      after_create.push_back(created.at(fk->parent));
+      // if parent has no records, child can't have records
+      if (fk->parent->number_of_initial_records == 0)
+        table->number_of_initial_records = 0;
+    }
+    auto create = tasks.add(
+        "create_table",
+        [table](Thd1 *thd) { return create_table(table, thd); }, after_create);
+    created[table] = create;
+
+    std::vector<Task_id> after_load = {create};
+    int64_t records = load_rows ? table->number_of_initial_records : 0;
+    int64_t size = chunk_size > 0 ? chunk_size : records;
+    for (int64_t first = 0; first < records; first += size) {
+      Load_chunk chunk = {table, first, std::min(records, first + size)};
+      after_load.push_back(tasks.add(
+          "load_chunk", [chunk](Thd1 *thd) { return load_chunk(chunk, thd); },
+          {create}));
+    }
+    if (fk)
+      after_load.push_back(completed.at(fk->parent));
+    auto complete = tasks.add(
+        "load_indexes",
+        [table](Thd1 *thd) {
+          if (!table->load_indexes(thd))
+            return false;
+          if (table->shadow_keys && table->shadow_keys->seeding)
+            table->shadow_keys->ready = true;
+          table_completed++;
+          return true;
+        },
+        after_load);
+    completed[table] = complete;
+    all_completed.push_back(complete);
+  }
+
+  if (!options->at(Option::PREPARE)->getBool() ||
+      !options->at(Option::REUSE_DATASET)->getBool())
+    return;
+
+  /* save row count and checksum of tables once all of them are loaded. A
+   * failure only means next prepare loads again, so it does not fail load */
+  auto dataset = tasks.add(
+      "create_dataset_table",
+      [](Thd1 *thd) {
+        execute_sql("CREATE TABLE " + DATASET_TABLE +
+                        " (table_name VARCHAR(64) PRIMARY KEY, "
+                        "fingerprint CHAR(16), row_count BIGINT, "
+                        "checksum BIGINT UNSIGNED)",
+                    thd);
+        return true;
+      },
+      all_completed);
+  for (auto table : *all_tables) {
+    tasks.add(
+        "save_dataset_table",
+        [table](Thd1 *thd) {
+          auto rows = mysql_read_single_value(
+              "SELECT COUNT(*) FROM " + table->name_, thd);
+          auto checksum = table_checksum(table->name_, thd);
+          if (rows.empty() || checksum.empty()) {
+            thd->thread_log << "Unable to save " << table->name_
+                            << " in dataset" << std::endl;
+            return true;
+          }
+          execute_sql("INSERT INTO " + DATASET_TABLE + " VALUES ('" +
+                          table->name_ + "', '" + dataset_id + "', " + rows +
+                          ", " + checksum + ")",
+                      thd);
+          return true;
+        },
+        {dataset});
+  }
+}
+
+/* plan --check-table-preload. Partitions of a table are checked in batches
+ * spread over all threads, so a table with many partitions does not keep one
+ * thread busy. A last task of the table adds up failures of its batches */
+static void plan_check_tasks() {
+  typedef Task_scheduler::Task_id Task_id;
+  size_t threads = std::max(options->at(Option::THREADS)->getInt(), 1);
+  startup_tasks.reset(
+      new Task_scheduler(threads, [] { return bool(run_query_failed); }));
+  wake_on_phase_changed(startup_tasks.get());
+  /* tables of a reused dataset are counted as loaded, the snapshot shows the
+   * progress of the check from 0 */
+  table_completed = 0;
+  for (auto table : *all_tables) {
+    auto failures = std::make_shared<std::atomic<size_t>>(0);
+    std::vector<Task_id> checks;
+    auto names = std::make_shared<const std::vector<std::string>>(
+        partition_names(table));
+    if (names->empty()) {
+      checks.push_back(
+          startup_tasks->add("check_table", [table, failures](Thd1 *thd) {
+            get_check_result("CHECK TABLE " + table->name_, thd) ||
+                (*failures)++;
+            return true;
+          }));
+    } else {
+      size_t batch = (names->size() + threads - 1) / threads;
+      for (size_t first = 0; first < names->size(); first += batch) {
+        size_t last = std::min(names->size(), first + batch);
+        checks.push_back(startup_tasks->add(
+            "check_partitions",
+            [table, names, first, last, failures](Thd1 *thd) {
+              *failures +=
+                  check_partitions_preload(table, *names, first, last, thd);
+              return true;
+            }));
+      }
+    }
+    startup_tasks->add(
+        "check_table_result",
+        [table, failures](Thd1 *thd) {
+          if (*failures != 0) {
+            check_failures++;
+            thd->stats.check_failed_tables.push_back(table->name_);
+          }
+          thd->stats.tables_checked++;
+          table_completed++;
+          return true;
+        },
+        checks);
+  }
+}
+
+static int64_t steady_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/* start of the workload, phases of --schedule-file are timed from it */
+static std::atomic<int64_t> workload_begin_ns(0); // steady clock
+
+/* --target-qps. Operations of all threads are started at a global rate, each
+ * operation claims the next due time from a shared schedule and its thread
+ * sleeps till then. Latency is measured from the due time, so a stalled
+ * server is not hidden by the threads waiting on it. Each role of
+ * --roles-file has its own schedule */
+struct Arrival_schedule {
+  std::atomic<int64_t> next_ns{0}; // steady clock
+  std::atomic<int> phase{-1};      // phase of next_ns, set after next_ns
+  std::mutex phase_mutex;          // serializes the change of phase
+};
+
+/* schedule of a role, roles are read before the threads start */
+static Arrival_schedule &role_arrival(int role) {
+  static std::deque<Arrival_schedule> arrivals(
+      std::max<size_t>(schedule_roles().size(), 1));
+  return arrivals.at(std::max(role, 0));
+}
+
+/* gap between the due times of two operations in nano-seconds */
+static double arrival_gap_ns(int target_qps) {
+  static const bool poisson =
+      options->at(Option::ARRIVAL)->getString() == "poisson";
+  double mean = 1e9 / target_qps;
+  if (!poisson)
+    return mean;
+  std::exponential_distribution<double> dist(1.0 / mean);
+  return dist(rng);
+}
+
+/* claim due time of the next operation. The schedule starts at the beginning
+ * of a phase that follows a closed loop phase, else backlog of the previous
+ * phase is carried over */
+static std::chrono::steady_clock::time_point
+next_arrival(const Phase_load &load, Arrival_schedule &arrival) {
+  /* threads of the new phase claim due times only once it is reset */
+  if (arrival.phase != load.phase) {
+    std::lock_guard<std::mutex> lock(arrival.phase_mutex);
+    if (arrival.phase != load.phase) {
+      if (load.phase == 0 ||
+          schedule_phases()[load.phase - 1].target_qps == 0)
+        arrival.next_ns =
+            workload_begin_ns +
+            static_cast<int64_t>(schedule_phases()[load.phase].begin * 1e9);
+      arrival.phase = load.phase;
+    }
+  }
+  auto ns = arrival.next_ns.fetch_add(
+      static_cast<int64_t>(arrival_gap_ns(load.target_qps)));
+  return std::chrono::steady_clock::time_point(
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::nanoseconds(ns)));
+}
+
+/* tables of a thread with --table-affinity disjoint or overlap. A table and
+ * its FK children are a group, as DML on a child locks rows of its parent.
+ * Groups are dealt to the threads in turn, with fewer groups than threads some
+ * threads share a group. Session temporary tables are always its own */
+static std::vector<Table *> affinity_tables(const std::vector<Table *> &temp,
+                                            int thread_id) {
+  std::vector<Table *> tables(temp);
+  auto root = [](Table *table) {
+    while (table->type == Table::FK &&
+           static_cast<FK_table *>(table)->parent != nullptr)
+      table = static_cast<FK_table *>(table)->parent;
+    return table;
+  };
+  std::map<Table *, size_t> groups; // by root table
+  for (auto table : *all_tables)
+    groups.emplace(root(table), groups.size());
+  if (groups.empty())
+    return tables;
+
+  size_t threads = std::max(options->at(Option::THREADS)->getInt(), 1);
+  static std::once_flag warned;
+  if (groups.size() < threads)
+    std::call_once(warned, [&] {
+      std::cout << "--table-affinity has " << groups.size()
+                << " table groups for " << threads
+                << " threads, some threads share tables" << std::endl;
+    });
+  for (auto table : *all_tables) {
+    auto group = groups.at(root(table));
+    if (groups.size() < threads ? group == thread_id % groups.size()
+                                : group % threads == size_t(thread_id))
+      tables.push_back(table);
+  }
+  return tables;
+}
+
 /* return true if successful or error out in case of fail */
 bool Thd1::run_some_query() {
-  std::vector<Table::TABLE_TYPES> tableTypes = {Table::NORMAL, Table::FK,
-                                                Table::PARTITION};
   execute_sql("USE " + options->at(Option::DATABASE)->getString(), this);
 
   /* first create temporary tables metadata if requried */
@@ -3601,71 +4774,42 @@ bool Thd1::run_some_query() {
   for (int i = 0; i < temp_tables; i++) {
 
     Table *table = Table::table_id(Table::TEMPORARY, i);
+    init_shadow_keys(table);
     if (!table->load(this))
       return false;
+    if (table->shadow_keys)
+      table->shadow_keys->ready = true;
     all_session_tables->push_back(table);
   }
 
-  /* prepare is passed, create all tables */
-  if (options->at(Option::PREPARE)->getBool() ||
-      options->at(Option::STEP)->getInt() == 1) {
-    auto current = table_started++;
-
-    while (current <= options->at(Option::TABLES)->getInt()) {
-      /* first load normal table , then FK and then partition
-       FK table uses thd->unique_key vector to pick random FK
-       thd->unique_key is populated from primary key */
-
-      for (const auto &tableType : tableTypes) {
-        auto table = pick_table(tableType, current + 1);
-        if (table == nullptr)
-          continue;
-        if (!table->load(this)) {
-          return false;
-        }
-      table_completed++;
-      }
-      current = table_started++;
-    }
+  auto load_begin = std::chrono::system_clock::now();
 
-    // wait for all tables to finish loading
-    while (table_completed < all_tables->size()) {
-      thread_log << "Waiting for all threds to finish initial load "
-                 << std::endl;
-      std::chrono::seconds dura(1);
-      if (run_query_failed) {
-        thread_log << "Some other thread failed, Exiting. Please check logs "
-                   << std::endl;
-        return false;
-      }
-      std::this_thread::sleep_for(dura);
-    }
+  /* prepare is passed, create all tables */
+  if ((options->at(Option::PREPARE)->getBool() ||
+       options->at(Option::STEP)->getInt() == 1) &&
+      !dataset_reused) {
+    Load_session load_session(this);
+    std::call_once(startup_tasks_planned, plan_load_tasks);
+    if (!startup_tasks->run(this, thread_id))
+      return false;
     /* table initial data is created delete , empty the unique_keys */
-    this->unique_keys.resize(0);
+    this->unique_keys = Load_keys();
 
   } else if (options->at(Option::CHECK_TABLE_PRELOAD)->getBool()) {
-    int number_of_tables = all_tables->size();
-    auto current = table_started++;
-
-    while (current < number_of_tables) {
-      auto table = all_tables->at(current);
-      check_tables_partitions_preload(table, this);
-      table_completed++;
-      current = table_started++;
-    }
-
-    // wait for all tables to finish check table
-    while (table_completed < all_tables->size()) {
-      thread_log << "Waiting for all threds to finish check tables "
-                 << std::endl;
-      std::chrono::seconds dura(1);
-      std::this_thread::sleep_for(dura);
-    }
+    std::call_once(startup_tasks_planned, plan_check_tasks);
+    if (!startup_tasks->run(this, thread_id))
+      return false;
   }
 
+  stats.load_seconds = std::chrono::duration<double>(
+                           std::chrono::system_clock::now() - load_begin)
+                           .count();
+
   if (options->at(Option::JUST_LOAD_DDL)->getBool() ||
-      options->at(Option::PREPARE)->getBool())
+      options->at(Option::PREPARE)->getBool()) {
+    stats_add_thread(stats);
     return true;
+  }
 
   /*Print once on screen and in general logs */
   if (!lock_stream.test_and_set()) {
@@ -3681,15 +4825,32 @@ bool Thd1::run_some_query() {
     this->ddl_logs << s.str();
   }
 
+  seed_shadow_keys(this);
+
   auto sec = opt_int(NUMBER_OF_SECONDS_WORKLOAD);
   auto begin = std::chrono::system_clock::now();
   auto end =
       std::chrono::system_clock::time_point(begin + std::chrono::seconds(sec));
+  auto steady_end =
+      std::chrono::steady_clock::now() + std::chrono::seconds(sec);
+
+  /* phases of the workload start with the first thread */
+  int64_t not_started = 0;
+  workload_begin_ns.compare_exchange_strong(not_started, steady_ns());
 
   /* set seed for current thread */
   rng = std::mt19937(set_seed(this));
   thread_log << " value of rand_int(100) " << rand_int(100) << std::endl;
 
+  /* --table-affinity, tables the thread picks from */
+  std::vector<Table *> own_tables;
+  auto affinity = options->at(Option::TABLE_AFFINITY)->getString();
+  if (affinity != "shared")
+    own_tables = affinity_tables(*all_session_tables, thread_id);
+  auto overlap = affinity == "overlap"
+                     ? options->at(Option::AFFINITY_OVERLAP)->getInt()
+                     : 0;
+
   /* combine session tables with all tables */
   all_session_tables->insert(all_session_tables->end(), all_tables->begin(),
                              all_tables->end());
@@ -3697,12 +4858,51 @@ bool Thd1::run_some_query() {
   /* freqency of all options per thread */
   int opt_feq[Option::MAX][2] = {{0, 0}};
 
+  /* role of --roles-file, it keeps its option mix and target qps */
+  auto role = schedule_role(thread_id);
+  auto &arrival = role_arrival(role);
+
   static auto savepoint_prob = options->at(Option::SAVEPOINT_PRB_K)->getInt();
 
   int trx_left = 0;
   int current_save_point = 0;
   while (std::chrono::system_clock::now() < end) {
 
+    Phase_load load;
+    if (!schedule_at((steady_ns() - workload_begin_ns) / 1e9, load))
+      break;
+    warmup = schedule_phases()[load.phase].warmup;
+    if (role >= 0)
+      load.target_qps = schedule_roles()[role].target_qps;
+
+    /* thread is not needed in this phase, end its transaction and wait */
+    if (thread_id >= load.threads) {
+      if (trx_left > 0) {
+        execute_sql("COMMIT", this);
+        trx_left = 0;
+        current_save_point = 0;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      if (run_query_failed)
+        break;
+      continue;
+    }
+
+    auto due = std::chrono::steady_clock::now();
+    if (load.target_qps > 0) {
+      due = next_arrival(load, arrival);
+      if (due >= steady_end)
+        break;
+      std::this_thread::sleep_until(due);
+      auto lag_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - due)
+                        .count();
+      if (!warmup) {
+        stats.schedule_lag.add(lag_us);
+        if (lag_us >= 1000)
+          stats.late_starts++;
+      }
+    }
 
     /* check if we need to make sql as part of existing or new trx */
     if (trx_left > 0) {
@@ -3736,10 +4936,22 @@ bool Thd1::run_some_query() {
       trx_left = rand_int(options->at(Option::TRANSACTIONS_SIZE)->getInt(), 1);
     }
 
-    auto table =
-        all_session_tables->at(rand_int(all_session_tables->size() - 1));
-    auto option = pick_some_option();
+    auto &pick_tables = own_tables.empty() || rand_int(99) < overlap
+                            ? *all_session_tables
+                            : own_tables;
+    auto table = pick_tables.at(rand_int(pick_tables.size() - 1));
+    auto option = pick_some_option(load.phase, role);
+    current_option.store(option, std::memory_order_relaxed);
     ddl_query = options->at(option)->ddl == true ? true : false;
+    /* whole option, its sql generation is the time not in nested spans */
+    Trace_span option_span(options->at(option)->getName(), "option");
+    /* open loop latency includes the time the operation waited for a thread */
+    auto option_begin =
+        load.target_qps > 0 ? due : std::chrono::steady_clock::now();
+    shape.option = option;
+    shape.table_type = table->type;
+    if (table->type == Table::PARTITION)
+      shape.partition_type = static_cast<Partition *>(table)->part_type;
 
     switch (option) {
     case Option::DROP_INDEX:
@@ -3849,14 +5061,33 @@ bool Thd1::run_some_query() {
       create_alter_drop_undo(this);
       break;
     case Option::GRAMMAR_SQL:
-      grammar_sql(all_session_tables, this);
+      grammar_sql(&pick_tables, this);
       break;
 
     default:
       throw std::runtime_error("invalid options");
     }
 
+    auto option_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::steady_clock::now() - option_begin)
+                         .count();
     options->at(option)->total_queries++;
+    count_option(option, success, option_us);
+    /* warm-up phases are only in the statistics of their phase */
+    Option_stats *counted[] = {
+        &stats.phases[load.phase], warmup ? nullptr : &stats.options[option],
+        warmup ? nullptr : &stats.tables[table->name_],
+        warmup || role < 0 ? nullptr : &stats.roles[role]};
+    for (auto counter : counted) {
+      if (counter == nullptr)
+        continue;
+      counter->latency.add(option_us);
+      counter->total++;
+      if (success)
+        counter->success++;
+    }
+    if (server_timing_pending)
+      sample_server_timing(this);
 
     /* sql executed is at 0 index, and if successful at 1 */
     opt_feq[option][0]++;
@@ -3865,11 +5096,28 @@ bool Thd1::run_some_query() {
       opt_feq[option][1]++;
       success = false;
     }
+    shape.clear();
+    current_option.store(-1, std::memory_order_relaxed);
 
     if (run_query_failed) {
       break;
     }
   } // while
+  warmup = false;
+
+  /* throughput of the run is of the time outside warm-up phases */
+  stats.seconds = std::chrono::duration<double>(
+                      std::chrono::system_clock::now() - begin)
+                      .count();
+  stats.seconds -= schedule_warmup_seconds(stats.seconds);
+  auto last_qps = role >= 0 ? schedule_roles()[role].target_qps
+                            : schedule_phases().back().target_qps;
+  if (last_qps > 0) {
+    auto behind_ns = steady_ns() - arrival.next_ns.load();
+    if (behind_ns > 0)
+      stats.backlog = behind_ns / 1e9 * last_qps;
+  }
+  stats_add_thread(stats);
 
   /* print options frequency in logs */
   for (int i = 0; i < Option::MAX; i++) {
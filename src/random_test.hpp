@@ -2,6 +2,9 @@
 #define __RANDOM_HPP__
 
 #include "common.hpp"
+#include "keys.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
 #include <algorithm>
 #include <atomic>
 #include <cstdio>
@@ -9,6 +12,7 @@
 #include <document.h>
 #include <filereadstream.h>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <memory> //shared_ptr
 #include <mutex>
@@ -38,6 +42,7 @@
 #define opt_string(a) options->at(Option::a)->getString()
 
 int rand_int(int upper, int lower = 0);
+int64_t rand_int64(int64_t upper, int64_t lower = 0);
 std::string rand_float(float upper, float lower = 0);
 std::string rand_double(double upper, double lower = 0);
 std::string rand_string(int upper, int lower = 0);
@@ -50,6 +55,7 @@ public:
              PARTITION */
     INTEGER,
     INT,
+    BIGINT,
     CHAR,
     VARCHAR,
     FLOAT,
@@ -147,6 +153,13 @@ struct Index {
   std::vector<Ind_col *> *columns_;
 };
 
+/* operations of an option for the live snapshot */
+struct Option_counts {
+  unsigned long total = 0;
+  unsigned long success = 0;
+  unsigned long long us = 0; // time spent in micro-seconds
+};
+
 struct Thd1 {
   Thd1(int id, std::ofstream &tl, std::ofstream &ddl_l, std::ofstream &client_l,
        MYSQL *c, std::atomic<unsigned long long> &p,
@@ -167,13 +180,45 @@ struct Thd1 {
   std::atomic<unsigned long long> &failed_queries_total;
   std::shared_ptr<MYSQL_RES> result; // result set of sql
   bool ddl_query = false;     // is the query ddl
+  bool warmup = false;        // running a warm-up phase of the workload
   bool success = false;       // if the sql is successfully executed
   int max_con_fail_count = 0; // consecutive failed queries
 
-  /* for loading Bulkdata, Primary key of current table is stored in this vector
-   * which  is used for the FK tables  */
-  std::vector<int> unique_keys;
+  /* for loading Bulkdata, Primary keys of current table, which are used for the
+   * FK tables */
+  Load_keys unique_keys;
   int query_number = 0;
+  Run_stats stats; // statistics of the workload run by thread
+  Statement_shape shape; // shape of the sql being generated
+
+  /* --server-timing-sample, ps_thread_id is the performance_schema
+   * THREAD_ID of the connection, 0 if not sampled and -1 if unavailable.
+   * sampled_client_us is the client time of the last query */
+  long long ps_thread_id = 0;
+  int queries_since_sample = 0;
+  bool server_timing_pending = false;
+  long long sampled_client_us = 0;
+
+  /* state read by the stall watchdog and the live snapshot. query_start is in
+   * milli-seconds of steady_clock and 0 if no query is running. in_flight_sql
+   * is only set with --stall-threshold */
+  void set_in_flight(const std::string *sql);
+  alignas(64) std::atomic<uint64_t> query_start{0};
+  std::atomic<int> current_option{-1}; // option being run, -1 if none
+  std::mutex in_flight_mutex;          // protects in_flight_sql
+  const std::string *in_flight_sql = nullptr;
+
+  /* operations by option for the live snapshot. Only the thread writes its
+   * counters, the snapshot thread sums them over the threads */
+  void count_option(int option, bool success, unsigned long long us);
+  Option_counts option_counts(int option) const;
+  struct Option_counters {
+    std::atomic<unsigned long> total{0};
+    std::atomic<unsigned long> success{0};
+    std::atomic<unsigned long long> us{0};
+  };
+  std::unique_ptr<Option_counters[]> option_counters{
+      new Option_counters[Option::MAX]};
 };
 
 /* Table basic properties */
@@ -184,7 +229,8 @@ struct Table {
   static Table *table_id(TABLE_TYPES choice, int id);
   std::string definition(bool with_index = true);
   /* add secondary indexes */
-  bool load_secondary_indexes(Thd1 *thd);
+  bool load_secondary_indexes(Thd1 *thd, const std::string &extra = "");
+  bool load_indexes(Thd1 *thd);
   /* execute table definition, Bulk data and then secondary index */
   bool load(Thd1 *thd);
   static std::string &prepare_like_string(std::string &&str);
@@ -207,6 +253,12 @@ struct Table {
   void ModifyColumn(Thd1 *thd);
   void InsertRandomRow(Thd1 *thd);
   bool InsertBulkRecord(Thd1 *thd);
+  bool InsertRecords(Thd1 *thd, const Load_keys &pk_keys,
+                     const Load_keys &fk_unique_keys, int64_t first,
+                     int64_t last);
+  bool LoadDataInfile(Thd1 *thd, const Load_keys &pk_keys,
+                      const Load_keys &fk_unique_keys, int64_t first,
+                      int64_t last, bool is_list_partition);
   void DropColumn(Thd1 *thd);
   void AddColumn(Thd1 *thd);
   void DropIndex(Thd1 *thd);
@@ -215,6 +267,7 @@ struct Table {
   void DeleteRandomRow(Thd1 *thd);
   void UpdateRandomROW(Thd1 *thd);
   void SelectRandomRow(Thd1 *thd);
+  std::string point_value(Column *col);
   void SelectAllRow(Thd1 *thd);
   void DeleteAllRows(Thd1 *thd);
   void ColumnRename(Thd1 *thd);
@@ -229,12 +282,17 @@ struct Table {
   std::string compression;
   std::string encryption = "N";
   int key_block_size = 0;
-  int number_of_initial_records;
+  int64_t number_of_initial_records;
+  /* primary keys of initial records while table is loaded in chunks, FK
+   * child tables pick their keys from it */
+  Load_keys load_keys;
+  Recent_keys recent_keys; // primary keys last inserted
+  std::unique_ptr<Key_set> shadow_keys; // --shadow-keys, primary keys present
   size_t auto_inc_index;
   // std::string data_directory; todo add corressponding code
   std::vector<Column *> *columns_;
   std::vector<Index *> *indexes_;
-  std::mutex table_mutex;
+  Traced_mutex table_mutex{"table_mutex"};
 
   const std::string get_type() const {
     switch (type) {
@@ -280,6 +338,7 @@ struct FK_table : Table {
    Used to get distince keys of pkey table */
   Table* parent;
   bool load_fk_constraint(Thd1 *thd);
+  std::string fk_constraint_clause();
 
   void pickRefrence(Table *table) {
     on_delete = getRandomForeignKeyAction(table);
@@ -394,9 +453,9 @@ public:
 
   /* Used by Range Parititon */
   struct Range {
-    Range(std::string n, int r) : name(n), range(r){};
+    Range(std::string n, int64_t r) : name(n), range(r){};
     std::string name;
-    int range;
+    int64_t range;
   };
   std::vector<Range> positions;
   static bool compareRange(Range P1, Range P2) { return P1.range < P2.range; }
@@ -420,7 +479,7 @@ struct Temporary_table : Table {
 int set_seed(Thd1 *thd);
 int sum_of_all_options(Thd1 *thd);
 int sum_of_all_server_options();
-Option::Opt pick_some_option();
+Option::Opt pick_some_option(int phase, int role = -1);
 std::vector<std::string> *random_strs_generator(unsigned long int seed);
 bool load_metadata(Thd1 *thd);
 
@@ -431,6 +490,19 @@ param[in/out] thd	Thd used to execute sql
 bool execute_sql(const std::string &sql, Thd1 *thd);
 
 void save_metadata_to_file();
+void load_progress(size_t &done, size_t &total);
+
+/* find performance_schema THREAD_ID of the connection for
+ * --server-timing-sample, before the thread runs any query */
+void server_timing_connect(Thd1 *thd);
+
+/* Threads waiting for a startup phase (metadata load, initial load, check of
+tables) sleep on a condition variable. phase_changed() wakes them, it is called
+when a phase counter changes or a thread fails
+@return false if some thread failed before the phase is done */
+void phase_changed();
+bool wait_for_phase(Thd1 *thd, const std::function<bool()> &done,
+                    const char *phase);
 void clean_up_at_end();
 void alter_tablespace_encryption(Thd1 *thd);
 void alter_tablespace_rename(Thd1 *thd);
@@ -439,5 +511,5 @@ void add_server_options(std::string str);
 void alter_database_encryption(Thd1 *thd);
 void create_in_memory_data();
 void generate_metadata_for_tables();
-void create_database_tablespace(Thd1 *thd);
+void create_database(Thd1 *thd);
 #endif
@@ -0,0 +1,163 @@
+#include "schedule.hpp"
+#include "common.hpp"
+#include <INIReader.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+static std::vector<Workload_phase> phases;
+static std::vector<Workload_role> roles;
+
+static void invalid_schedule(const std::string &file, const std::string &msg,
+                             const char *option = "--schedule-file") {
+  std::cout << "Invalid " << option << " " << file << ": " << msg << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+/* weights of sql options set in a section of the file */
+static std::map<int, int> section_weights(INIReader &reader,
+                                          const std::string &section) {
+  std::map<int, int> weights;
+  for (auto opt : *options) {
+    if (opt == nullptr || !opt->sql)
+      continue;
+    auto weight = reader.GetInteger(section, opt->getName(), -1);
+    if (weight >= 0)
+      weights[opt->getOption()] = weight;
+  }
+  return weights;
+}
+
+static void roles_load() {
+  roles.clear();
+  auto file = options->at(Option::ROLES_FILE)->getString();
+  if (file.empty())
+    return;
+  if (!options->at(Option::SCHEDULE_FILE)->getString().empty())
+    invalid_schedule(file, "it can't be used with --schedule-file",
+                     "--roles-file");
+
+  INIReader reader(file);
+  if (reader.ParseError() != 0)
+    invalid_schedule(file,
+                     "can't parse line " + std::to_string(reader.ParseError()),
+                     "--roles-file");
+
+  int threads = 0;
+  for (auto &section : reader.GetSections()) {
+    Workload_role role;
+    role.name = section;
+    role.threads = reader.GetInteger(section, "threads", 0);
+    role.target_qps = reader.GetInteger(section, "target-qps", 0);
+    if (role.threads <= 0)
+      invalid_schedule(file, "role " + section + " needs threads above 0",
+                       "--roles-file");
+    if (role.target_qps < 0)
+      invalid_schedule(file,
+                       "role " + section + " needs target-qps of 0 or more",
+                       "--roles-file");
+    role.weights = section_weights(reader, section);
+    role.first_thread = threads;
+    threads += role.threads;
+    roles.push_back(role);
+  }
+  if (roles.empty())
+    invalid_schedule(file, "no role", "--roles-file");
+
+  options->at(Option::THREADS)->setInt(threads);
+  phases.front().threads = threads;
+}
+
+void schedule_load() {
+  phases.clear();
+  auto seconds = options->at(Option::NUMBER_OF_SECONDS_WORKLOAD)->getInt();
+  auto threads = options->at(Option::THREADS)->getInt();
+  auto target_qps = options->at(Option::TARGET_QPS)->getInt();
+  auto file = options->at(Option::SCHEDULE_FILE)->getString();
+  if (file.empty()) {
+    phases.push_back(
+        {"workload", seconds, threads, target_qps, false, false, {}, 0});
+    roles_load();
+    return;
+  }
+
+  INIReader reader(file);
+  if (reader.ParseError() != 0)
+    invalid_schedule(file, "can't parse line " +
+                               std::to_string(reader.ParseError()));
+
+  double begin = 0;
+  int max_threads = 0;
+  for (auto &section : reader.GetSections()) {
+    Workload_phase phase;
+    phase.name = section;
+    phase.seconds = reader.GetInteger(section, "seconds", 0);
+    phase.threads = threads = reader.GetInteger(section, "threads", threads);
+    phase.target_qps = target_qps =
+        reader.GetInteger(section, "target-qps", target_qps);
+    phase.warmup = reader.GetBoolean(section, "warmup", false);
+    phase.ramp = reader.GetBoolean(section, "ramp", false);
+    if (phase.seconds <= 0 || phase.threads <= 0)
+      invalid_schedule(file, "phase " + section +
+                                 " needs seconds and threads above 0");
+    if (phase.target_qps < 0)
+      invalid_schedule(file, "phase " + section +
+                                 " needs target-qps of 0 or more");
+    phase.weights = section_weights(reader, section);
+    phase.begin = begin;
+    begin += phase.seconds;
+    max_threads = std::max(max_threads, phase.threads);
+    phases.push_back(phase);
+  }
+  if (phases.empty())
+    invalid_schedule(file, "no phase");
+  roles_load();
+
+  options->at(Option::NUMBER_OF_SECONDS_WORKLOAD)
+      ->setInt(static_cast<int>(begin));
+  options->at(Option::THREADS)->setInt(max_threads);
+}
+
+const std::vector<Workload_phase> &schedule_phases() { return phases; }
+
+const std::vector<Workload_role> &schedule_roles() { return roles; }
+
+int schedule_role(int thread_id) {
+  for (size_t i = 0; i < roles.size(); i++) {
+    if (thread_id < roles[i].first_thread + roles[i].threads)
+      return i;
+  }
+  return -1;
+}
+
+bool schedule_at(double seconds, Phase_load &load) {
+  for (size_t i = 0; i < phases.size(); i++) {
+    auto &phase = phases[i];
+    if (seconds >= phase.begin + phase.seconds)
+      continue;
+    load.phase = i;
+    load.threads = phase.threads;
+    load.target_qps = phase.target_qps;
+    if (phase.ramp && i > 0) {
+      auto &prev = phases[i - 1];
+      auto done = std::max(seconds - phase.begin, 0.0) / phase.seconds;
+      load.threads =
+          prev.threads + std::lround((phase.threads - prev.threads) * done);
+      load.target_qps =
+          prev.target_qps +
+          std::lround((phase.target_qps - prev.target_qps) * done);
+    }
+    return true;
+  }
+  return false;
+}
+
+double schedule_warmup_seconds(double seconds) {
+  double warmup = 0;
+  for (auto &phase : phases) {
+    if (phase.warmup)
+      warmup += std::max(
+          std::min(seconds, phase.begin + phase.seconds) - phase.begin, 0.0);
+  }
+  return warmup;
+}
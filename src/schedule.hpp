@@ -0,0 +1,94 @@
+#ifndef __SCHEDULE_HPP__
+#define __SCHEDULE_HPP__
+
+#include <map>
+#include <string>
+#include <vector>
+
+/* Phase of the workload of a step. Without --schedule-file the workload is one
+phase of --seconds with --threads and --target-qps. A --schedule-file has one
+INI section for each phase, in the order they run, e.g.
+
+[warmup]
+seconds=60
+threads=4
+warmup=1
+[ramp]
+seconds=120
+threads=32
+target-qps=20000
+ramp=1
+[hold]
+seconds=600
+select-single-row=800
+
+Missing threads and target-qps keep the value of the previous phase, the first
+phase takes them from the command line. Any sql option can be given to change
+its weight in the phase */
+struct Workload_phase {
+  std::string name;
+  int seconds;
+  int threads;    // threads running queries, other threads wait
+  int target_qps; // 0 is closed loop
+  bool warmup;    // latency of the phase is not in the run statistics
+  bool ramp; // threads and target qps move linearly from the previous phase
+  std::map<int, int> weights; // option weights set by phase, by Option::Opt
+  double begin;               // seconds from the start of the workload
+};
+
+/* Group of threads of the workload with its own mix of sql options. A
+--roles-file has one INI section for each role, e.g.
+
+[readers]
+threads=48
+select-single-row=900
+select-all-rows=100
+[writers]
+threads=12
+target-qps=3000
+insert-row=500
+update-with-cond=500
+[ddl]
+threads=4
+alter-table-encrypt=1
+alter-table-compress=1
+
+Threads are given to roles in the order of the sections. A role runs only the
+options it lists, a role without options runs the mix of the command line.
+target-qps is the rate of operations of the role, 0 is closed loop */
+struct Workload_role {
+  std::string name;
+  int threads;
+  int target_qps;
+  std::map<int, int> weights; // by Option::Opt, empty for command line mix
+  int first_thread;           // thread_id of the first thread of the role
+};
+
+/* threads and target qps at a moment of the workload */
+struct Phase_load {
+  int phase;
+  int threads;
+  int target_qps;
+};
+
+/* read --schedule-file or --roles-file. --seconds is set to the total of the
+ * phases and --threads to the maximum, or to the threads of all roles, so the
+ * node starts enough threads. Exits if the file is invalid */
+void schedule_load();
+
+const std::vector<Workload_phase> &schedule_phases();
+
+/* roles of --roles-file, empty without it */
+const std::vector<Workload_role> &schedule_roles();
+
+/* @return role of a thread, -1 without --roles-file */
+int schedule_role(int thread_id);
+
+/* load at seconds from the start of the workload
+@return false if the last phase is over */
+bool schedule_at(double seconds, Phase_load &load);
+
+/* seconds of the first seconds of workload spent in warm-up phases */
+double schedule_warmup_seconds(double seconds);
+
+#endif
@@ -0,0 +1,102 @@
+#include "scheduler.hpp"
+#include "trace.hpp"
+#include <utility>
+
+Task_scheduler::Task_scheduler(size_t workers, Stopped stopped)
+    : stopped(std::move(stopped)) {
+  for (size_t i = 0; i < std::max<size_t>(workers, 1); i++)
+    queues.emplace_back(new Queue);
+}
+
+Task_scheduler::Task_id Task_scheduler::add(const char *kind, Work work,
+                                            const std::vector<Task_id> &after) {
+  Task_id id = tasks.size();
+  tasks.emplace_back(new Task);
+  auto &task = *tasks.back();
+  task.kind = kind;
+  task.work = std::move(work);
+  task.waiting = after.size();
+  for (auto parent : after)
+    tasks.at(parent)->next.push_back(id);
+  /* tasks without dependency are spread over all the threads */
+  if (after.empty())
+    push(id % queues.size(), id);
+  return id;
+}
+
+void Task_scheduler::push(size_t worker, Task_id id) {
+  {
+    /* counted with the queue locked, so a pop can't take the task first */
+    std::lock_guard<std::mutex> lock(queues[worker]->mutex);
+    queues[worker]->ready.push_back(id);
+    ready++;
+  }
+  wake_all();
+}
+
+/* newest task of own queue, else oldest task of another queue */
+bool Task_scheduler::pop(size_t worker, Task_id &id) {
+  for (size_t i = 0; i < queues.size(); i++) {
+    auto &queue = *queues[(worker + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.ready.empty())
+      continue;
+    if (i == 0) {
+      id = queue.ready.back();
+      queue.ready.pop_back();
+    } else {
+      id = queue.ready.front();
+      queue.ready.pop_front();
+    }
+    ready--;
+    return true;
+  }
+  return false;
+}
+
+void Task_scheduler::wake_all() {
+  std::lock_guard<std::mutex> lock(idle_mutex);
+  idle_cv.notify_all();
+}
+
+bool Task_scheduler::run(Thd1 *thd, size_t worker) {
+  worker %= queues.size();
+  while (true) {
+    if (stopped && stopped()) {
+      failed = true;
+      wake_all();
+      return false;
+    }
+    Task_id id;
+    if (pop(worker, id)) {
+      auto &task = *tasks[id];
+      bool success;
+      {
+        Trace_span span(task.kind, "task");
+        success = task.work(thd);
+      }
+      if (!success) {
+        failed = true;
+        wake_all();
+        return false;
+      }
+      for (auto next : task.next) {
+        if (--tasks[next]->waiting == 0)
+          push(worker, next);
+      }
+      if (++done == tasks.size())
+        wake_all();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(idle_mutex);
+    idle_cv.wait(lock, [&] {
+      return ready > 0 || done == tasks.size() || failed ||
+             (stopped && stopped());
+    });
+    if (failed)
+      return false;
+    if (done == tasks.size())
+      return true;
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef __SCHEDULER_HPP__
+#define __SCHEDULER_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct Thd1;
+
+/* Scheduler of the jobs of a phase, e.g. initial load of tables.
+Tasks are added with the tasks they depend on, then every thread of the phase
+calls run() till all tasks are done. Each thread has its own queue of ready
+tasks. A finished task makes its dependents ready in the queue of the same
+thread, so an FK child mostly runs where its parent ran. A thread with an
+empty queue steals the oldest ready task of another thread */
+class Task_scheduler {
+public:
+  typedef size_t Task_id;
+  /* @return false if task failed, the phase is then aborted */
+  typedef std::function<bool(Thd1 *)> Work;
+  /* @return true if the phase must end because of a failure outside of it */
+  typedef std::function<bool()> Stopped;
+
+  explicit Task_scheduler(size_t workers, Stopped stopped = nullptr);
+
+  /* add a task that is ready once all tasks in after are done. Tasks can only
+   * be added before the first run()
+  @param[in] kind  kind of task, shown in trace, must be a string literal */
+  Task_id add(const char *kind, Work work,
+              const std::vector<Task_id> &after = {});
+
+  /* run tasks in the calling thread till all tasks are done
+  @return false if some task failed */
+  bool run(Thd1 *thd, size_t worker);
+
+  size_t size() const { return tasks.size(); }
+  size_t completed() const { return done; }
+
+  /* wake idle threads, they check stopped() again. Called by whoever sets the
+   * failure stopped() reports */
+  void wake_all();
+
+private:
+  struct Task {
+    const char *kind;
+    Work work;
+    std::atomic<size_t> waiting; // tasks not done yet it depends on
+    std::vector<Task_id> next;   // tasks that depend on it
+  };
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task_id> ready;
+  };
+
+  void push(size_t worker, Task_id id);
+  bool pop(size_t worker, Task_id &id);
+
+  std::vector<std::unique_ptr<Task>> tasks;
+  std::vector<std::unique_ptr<Queue>> queues;
+  Stopped stopped;
+  std::atomic<size_t> ready{0}; // changed under the lock of a queue
+  std::atomic<size_t> done{0};
+  std::atomic<bool> failed{false};
+  /* idle threads wait here for a ready task, end or failure of phase */
+  std::mutex idle_mutex;
+  std::condition_variable idle_cv;
+};
+
+#endif
@@ -0,0 +1,655 @@
+#include "stats.hpp"
+#include "schedule.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <mutex>
+#include <ostreamwrapper.h>
+#include <prettywriter.h>
+#include <document.h>
+#include <filereadstream.h>
+
+using namespace rapidjson;
+
+/* options executed less than this are too noisy to compare with baseline */
+static const unsigned long baseline_min_queries = 100;
+
+/* shapes executed less than this are not ranked by p99 */
+static const unsigned long digest_min_queries = 10;
+
+/* names in order of Table::TABLE_TYPES and Partition::PART_TYPE */
+static const char *table_type_names[] = {"partition", "normal", "temporary",
+                                         "fk"};
+static const char *partition_type_names[] = {"RANGE", "LIST", "HASH", "KEY"};
+static const char *predicate_names[] = {
+    "",          " WHERE =",       " WHERE >=",    " WHERE >= AND <=",
+    " WHERE IN", " WHERE BETWEEN", " WHERE NOT BETWEEN", " WHERE LIKE"};
+
+static std::mutex run_stats_mutex;
+static Run_stats run_stats;
+static std::vector<Node_report> node_reports;
+static std::vector<std::string> requested_options;
+static const std::chrono::steady_clock::time_point run_start =
+    std::chrono::steady_clock::now();
+
+static int bucket_of(uint64_t us) {
+  const int sub = Latency_histogram::SUB_BUCKETS;
+  if (us < static_cast<uint64_t>(sub))
+    return us;
+  int bit = 63 - __builtin_clzll(us);
+  if (bit >= Latency_histogram::MAX_BIT)
+    return Latency_histogram::BUCKETS - 1;
+  return (bit - 3) * sub + ((us >> (bit - 4)) & (sub - 1));
+}
+
+/* highest value that falls in the bucket */
+static uint64_t bucket_upper(int bucket) {
+  const int sub = Latency_histogram::SUB_BUCKETS;
+  if (bucket < sub)
+    return bucket;
+  int bit = bucket / sub + 3;
+  uint64_t lower = static_cast<uint64_t>(sub + bucket % sub) << (bit - 4);
+  return lower + (1ULL << (bit - 4)) - 1;
+}
+
+uint32_t Statement_shape::key() const {
+  return (option + 1) | (table_type + 1) << 10 | (partition_type + 1) << 13 |
+         partition_clause << 16 | predicate << 18 | primary_key << 22;
+}
+
+Statement_shape Statement_shape::from_key(uint32_t key) {
+  Statement_shape shape;
+  shape.option = static_cast<int>(key & 0x3ff) - 1;
+  shape.table_type = static_cast<int>(key >> 10 & 0x7) - 1;
+  shape.partition_type = static_cast<int>(key >> 13 & 0x7) - 1;
+  shape.partition_clause = static_cast<Partition_clause>(key >> 16 & 0x3);
+  shape.predicate = static_cast<Predicate>(key >> 18 & 0xf);
+  shape.primary_key = key >> 22 & 0x1;
+  return shape;
+}
+
+std::string Statement_shape::describe() const {
+  std::string str = option >= 0 ? options->at(option)->getName() : "unknown";
+  if (table_type >= 0)
+    str += std::string(" ") + table_type_names[table_type];
+  if (partition_type >= 0)
+    str += std::string("(") + partition_type_names[partition_type] + ")";
+  if (partition_clause == ONE_PARTITION)
+    str += " PARTITION(p)";
+  else if (partition_clause == PARTITIONS)
+    str += " PARTITION(p,..)";
+  str += predicate_names[predicate];
+  if (primary_key)
+    str += " on pk";
+  return str;
+}
+
+void Latency_histogram::add(uint64_t us) {
+  if (buckets.empty())
+    buckets.resize(BUCKETS);
+  buckets[bucket_of(us)]++;
+  count++;
+  sum += us;
+  if (us > max)
+    max = us;
+}
+
+void Latency_histogram::merge(const Latency_histogram &other) {
+  if (other.count == 0)
+    return;
+  if (buckets.empty())
+    buckets.resize(BUCKETS);
+  for (int i = 0; i < BUCKETS; i++)
+    buckets[i] += other.buckets[i];
+  count += other.count;
+  sum += other.sum;
+  max = std::max(max, other.max);
+}
+
+uint64_t Latency_histogram::percentile(double p) const {
+  if (count == 0)
+    return 0;
+  uint64_t rank = std::ceil(count * p / 100);
+  uint64_t seen = 0;
+  for (int i = 0; i < BUCKETS; i++) {
+    seen += buckets[i];
+    if (seen >= rank)
+      return std::min(bucket_upper(i), max);
+  }
+  return max;
+}
+
+void Run_stats::merge(const Run_stats &other) {
+  for (size_t i = 0; i < options.size(); i++) {
+    options[i].total += other.options[i].total;
+    options[i].success += other.options[i].success;
+    options[i].latency.merge(other.options[i].latency);
+  }
+  for (auto &shape : other.shapes) {
+    auto &stats = shapes[shape.first];
+    stats.total += shape.second.total;
+    stats.success += shape.second.success;
+    stats.latency.merge(shape.second.latency);
+  }
+  for (auto &table : other.tables) {
+    auto &stats = tables[table.first];
+    stats.total += table.second.total;
+    stats.success += table.second.success;
+    stats.latency.merge(table.second.latency);
+  }
+  for (auto &error : other.errors)
+    errors[error.first] += error.second;
+  load_seconds = std::max(load_seconds, other.load_seconds);
+  for (auto &table : other.table_loads) {
+    auto &load = table_loads[table.first];
+    load.rows += table.second.rows;
+    load.seconds += table.second.seconds;
+    load.index_seconds += table.second.index_seconds;
+  }
+  tables_checked += other.tables_checked;
+  check_failed_tables.insert(check_failed_tables.end(),
+                             other.check_failed_tables.begin(),
+                             other.check_failed_tables.end());
+  send_execute.merge(other.send_execute);
+  fetch.merge(other.fetch);
+  client.merge(other.client);
+  server.merge(other.server);
+  overhead.merge(other.overhead);
+  seconds = std::max(seconds, other.seconds);
+  schedule_lag.merge(other.schedule_lag);
+  late_starts += other.late_starts;
+  backlog = std::max(backlog, other.backlog);
+  for (auto &phase : other.phases) {
+    auto &stats = phases[phase.first];
+    stats.total += phase.second.total;
+    stats.success += phase.second.success;
+    stats.latency.merge(phase.second.latency);
+  }
+  for (auto &role : other.roles) {
+    auto &stats = roles[role.first];
+    stats.total += role.second.total;
+    stats.success += role.second.success;
+    stats.latency.merge(role.second.latency);
+  }
+}
+
+void stats_add_thread(const Run_stats &stats) {
+  std::lock_guard<std::mutex> lock(run_stats_mutex);
+  run_stats.merge(stats);
+}
+
+void stats_add_node(const Node_report &node) {
+  std::lock_guard<std::mutex> lock(run_stats_mutex);
+  node_reports.push_back(node);
+}
+
+static std::string option_value(Option *opt) {
+  switch (opt->getType()) {
+  case Option::BOOL:
+    return opt->getBool() ? "true" : "false";
+  case Option::INT:
+    return std::to_string(opt->getInt());
+  case Option::STRING:
+    return opt->getString();
+  }
+  return "";
+}
+
+void stats_save_requested_options() {
+  requested_options.clear();
+  for (auto opt : *options)
+    requested_options.push_back(opt == nullptr ? "" : option_value(opt));
+}
+
+static double error_rate(unsigned long total, unsigned long success) {
+  return total ? (total - success) * 100.0 / total : 0;
+}
+
+static void write_latency(PrettyWriter<OStreamWrapper> &writer,
+                          const Latency_histogram &latency) {
+  writer.StartObject();
+  writer.String("avg");
+  writer.Uint64(latency.average());
+  writer.String("p50");
+  writer.Uint64(latency.percentile(50));
+  writer.String("p95");
+  writer.Uint64(latency.percentile(95));
+  writer.String("p99");
+  writer.Uint64(latency.percentile(99));
+  writer.String("max");
+  writer.Uint64(latency.max);
+  writer.EndObject();
+}
+
+/* write the top --digest-top shapes ordered by less */
+template <typename Less>
+static void write_top_shapes(PrettyWriter<OStreamWrapper> &writer,
+                             const std::vector<uint32_t> &keys, Less less) {
+  auto top = keys;
+  size_t n = std::min<size_t>(options->at(Option::DIGEST_TOP)->getInt(),
+                              top.size());
+  std::partial_sort(top.begin(), top.begin() + n, top.end(), less);
+  writer.StartArray();
+  for (size_t i = 0; i < n; i++) {
+    auto &stats = run_stats.shapes[top[i]];
+    auto shape = Statement_shape::from_key(top[i]).describe();
+    writer.StartObject();
+    writer.String("shape");
+    writer.String(shape.c_str(), static_cast<SizeType>(shape.size()));
+    writer.String("queries");
+    writer.Uint64(stats.total);
+    writer.String("failed");
+    writer.Uint64(stats.total - stats.success);
+    writer.String("total_ms");
+    writer.Uint64(stats.latency.sum / 1000);
+    writer.String("avg_us");
+    writer.Uint64(stats.latency.average());
+    writer.String("p99_us");
+    writer.Uint64(stats.latency.percentile(99));
+    writer.String("max_us");
+    writer.Uint64(stats.latency.max);
+    writer.EndObject();
+  }
+  writer.EndArray();
+}
+
+void stats_write_summary(const std::string &file) {
+  std::lock_guard<std::mutex> lock(run_stats_mutex);
+  std::ofstream of(file, std::ios::out | std::ios::trunc);
+  if (!of.is_open()) {
+    std::cerr << "Unable to open summary file " << file << std::endl;
+    return;
+  }
+  OStreamWrapper osw(of);
+  PrettyWriter<OStreamWrapper> writer(osw);
+
+  writer.StartObject();
+  writer.String("version");
+  writer.String((std::string(PQVERSION) + "-" + PQREVISION).c_str());
+  writer.String("step");
+  writer.Int(options->at(Option::STEP)->getInt());
+  writer.String("seed");
+  writer.Int(options->at(Option::INITIAL_SEED)->getInt());
+  writer.String("threads");
+  writer.Int(options->at(Option::THREADS)->getInt());
+  writer.String("wall_seconds");
+  writer.Double(std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                              run_start)
+                    .count());
+  writer.String("load_seconds");
+  writer.Double(run_stats.load_seconds);
+  writer.String("seconds");
+  writer.Double(run_stats.seconds);
+
+  /* effective value of all options, and the ones pstress changed from what
+   * was passed or default, e.g. features disabled for the server version */
+  writer.String("settings");
+  writer.StartObject();
+  for (auto opt : *options) {
+    if (opt == nullptr)
+      continue;
+    writer.String(opt->getName());
+    switch (opt->getType()) {
+    case Option::BOOL:
+      writer.Bool(opt->getBool());
+      break;
+    case Option::INT:
+      writer.Int(opt->getInt());
+      break;
+    case Option::STRING:
+      writer.String(opt->getString().c_str());
+      break;
+    }
+  }
+  writer.EndObject();
+  writer.String("settings_changed");
+  writer.StartObject();
+  for (size_t i = 0; i < requested_options.size() && i < options->size();
+       i++) {
+    auto opt = options->at(i);
+    if (opt == nullptr || requested_options[i] == option_value(opt))
+      continue;
+    writer.String(opt->getName());
+    writer.StartObject();
+    writer.String("requested");
+    writer.String(requested_options[i].c_str());
+    writer.String("effective");
+    writer.String(option_value(opt).c_str());
+    writer.EndObject();
+  }
+  writer.EndObject();
+
+  writer.String("nodes");
+  writer.StartArray();
+  for (auto &node : node_reports) {
+    writer.StartObject();
+    writer.String("name");
+    writer.String(node.name.c_str());
+    writer.String("server_version");
+    writer.String(node.server_version.c_str());
+    writer.String("queries");
+    writer.Uint64(node.queries);
+    writer.String("failed");
+    writer.Uint64(node.failed);
+    writer.String("wall_seconds");
+    writer.Double(node.wall_seconds);
+    writer.EndObject();
+  }
+  writer.EndArray();
+
+  /* rows per second is of the time spent inserting in the table, with
+   * --load-chunk-size it is summed over all threads that loaded a chunk */
+  writer.String("load");
+  writer.StartObject();
+  unsigned long load_rows = 0;
+  double index_seconds = 0;
+  for (auto &table : run_stats.table_loads) {
+    writer.String(table.first.c_str());
+    writer.StartObject();
+    writer.String("rows");
+    writer.Uint64(table.second.rows);
+    writer.String("seconds");
+    writer.Double(table.second.seconds);
+    writer.String("rows_per_second");
+    writer.Double(table.second.seconds > 0
+                      ? table.second.rows / table.second.seconds
+                      : 0);
+    writer.String("index_seconds");
+    writer.Double(table.second.index_seconds);
+    writer.EndObject();
+    load_rows += table.second.rows;
+    index_seconds += table.second.index_seconds;
+  }
+  writer.EndObject();
+  writer.String("load_index_seconds");
+  writer.Double(index_seconds);
+  writer.String("load_rows_per_second");
+  writer.Double(run_stats.load_seconds > 0
+                    ? load_rows / run_stats.load_seconds
+                    : 0);
+
+  if (run_stats.schedule_lag.count > 0) {
+    unsigned long queries = 0;
+    for (auto &stats : run_stats.options)
+      queries += stats.total;
+    writer.String("open_loop");
+    writer.StartObject();
+    writer.String("target_qps");
+    writer.Int(options->at(Option::TARGET_QPS)->getInt());
+    writer.String("arrival");
+    writer.String(options->at(Option::ARRIVAL)->getString().c_str());
+    writer.String("achieved_qps");
+    writer.Double(run_stats.seconds > 0 ? queries / run_stats.seconds : 0);
+    writer.String("late_starts");
+    writer.Uint64(run_stats.late_starts);
+    writer.String("backlog");
+    writer.Uint64(run_stats.backlog);
+    writer.String("schedule_lag_us");
+    write_latency(writer, run_stats.schedule_lag);
+    writer.EndObject();
+  }
+
+  /* phases of --schedule-file, warm-up phases are only reported here */
+  if (!options->at(Option::SCHEDULE_FILE)->getString().empty()) {
+    writer.String("phases");
+    writer.StartArray();
+    auto &phases = schedule_phases();
+    for (size_t i = 0; i < phases.size(); i++) {
+      auto &stats = run_stats.phases[i];
+      writer.StartObject();
+      writer.String("name");
+      writer.String(phases[i].name.c_str());
+      writer.String("seconds");
+      writer.Int(phases[i].seconds);
+      writer.String("threads");
+      writer.Int(phases[i].threads);
+      writer.String("target_qps");
+      writer.Int(phases[i].target_qps);
+      writer.String("warmup");
+      writer.Bool(phases[i].warmup);
+      writer.String("queries");
+      writer.Uint64(stats.total);
+      writer.String("failed");
+      writer.Uint64(stats.total - stats.success);
+      writer.String("qps");
+      writer.Double(double(stats.total) / phases[i].seconds);
+      writer.String("latency_us");
+      write_latency(writer, stats.latency);
+      writer.EndObject();
+    }
+    writer.EndArray();
+  }
+
+  /* roles of --roles-file */
+  if (!schedule_roles().empty()) {
+    writer.String("roles");
+    writer.StartArray();
+    auto &roles = schedule_roles();
+    for (size_t i = 0; i < roles.size(); i++) {
+      auto &stats = run_stats.roles[i];
+      writer.StartObject();
+      writer.String("name");
+      writer.String(roles[i].name.c_str());
+      writer.String("threads");
+      writer.Int(roles[i].threads);
+      writer.String("target_qps");
+      writer.Int(roles[i].target_qps);
+      writer.String("queries");
+      writer.Uint64(stats.total);
+      writer.String("failed");
+      writer.Uint64(stats.total - stats.success);
+      writer.String("qps");
+      writer.Double(run_stats.seconds > 0 ? stats.total / run_stats.seconds
+                                          : 0);
+      writer.String("latency_us");
+      write_latency(writer, stats.latency);
+      writer.EndObject();
+    }
+    writer.EndArray();
+  }
+
+  writer.String("check_tables");
+  writer.StartObject();
+  writer.String("checked");
+  writer.Uint64(run_stats.tables_checked);
+  writer.String("failed");
+  writer.StartArray();
+  for (auto &table : run_stats.check_failed_tables)
+    writer.String(table.c_str());
+  writer.EndArray();
+  writer.EndObject();
+
+  writer.String("errors");
+  writer.StartObject();
+  for (auto &error : run_stats.errors) {
+    writer.String(std::to_string(error.first).c_str());
+    writer.Uint64(error.second);
+  }
+  writer.EndObject();
+
+  writer.String("tables");
+  writer.StartObject();
+  std::map<std::string, Option_stats *> tables; // sorted by name
+  for (auto &table : run_stats.tables)
+    tables[table.first] = &table.second;
+  for (auto &table : tables) {
+    writer.String(table.first.c_str());
+    writer.StartObject();
+    writer.String("queries");
+    writer.Uint64(table.second->total);
+    writer.String("failed");
+    writer.Uint64(table.second->total - table.second->success);
+    writer.String("latency_us");
+    write_latency(writer, table.second->latency);
+    writer.EndObject();
+  }
+  writer.EndObject();
+
+  writer.String("options");
+  writer.StartObject();
+  for (size_t i = 0; i < run_stats.options.size(); i++) {
+    auto &stats = run_stats.options[i];
+    if (stats.total == 0)
+      continue;
+    writer.String(options->at(i)->getName());
+    writer.StartObject();
+    writer.String("queries");
+    writer.Uint64(stats.total);
+    writer.String("failed");
+    writer.Uint64(stats.total - stats.success);
+    writer.String("error_rate");
+    writer.Double(error_rate(stats.total, stats.success));
+    writer.String("qps");
+    writer.Double(run_stats.seconds > 0 ? stats.total / run_stats.seconds : 0);
+    writer.String("latency_us");
+    write_latency(writer, stats.latency);
+    writer.EndObject();
+  }
+  writer.EndObject();
+
+  /* where the time of a query goes, overhead is network and client time of
+   * queries sampled by --server-timing-sample */
+  std::pair<const char *, const Latency_histogram *> phases[] = {
+      {"send_execute", &run_stats.send_execute},
+      {"fetch", &run_stats.fetch},
+      {"client", &run_stats.client},
+      {"server", &run_stats.server},
+      {"overhead", &run_stats.overhead}};
+  writer.String("phases_us");
+  writer.StartObject();
+  for (auto &phase : phases) {
+    if (phase.second->count == 0)
+      continue;
+    writer.String(phase.first);
+    write_latency(writer, *phase.second);
+  }
+  writer.EndObject();
+
+  std::vector<uint32_t> keys, frequent_keys;
+  for (auto &shape : run_stats.shapes) {
+    keys.push_back(shape.first);
+    if (shape.second.total >= digest_min_queries)
+      frequent_keys.push_back(shape.first);
+  }
+  writer.String("digests_by_total_latency");
+  write_top_shapes(writer, keys, [](uint32_t a, uint32_t b) {
+    return run_stats.shapes[a].latency.sum > run_stats.shapes[b].latency.sum;
+  });
+  writer.String("digests_by_p99_latency");
+  write_top_shapes(writer, frequent_keys, [](uint32_t a, uint32_t b) {
+    return run_stats.shapes[a].latency.percentile(99) >
+           run_stats.shapes[b].latency.percentile(99);
+  });
+
+  writer.EndObject();
+  of << std::endl;
+  std::cout << "Saving run report to " << file << std::endl;
+}
+
+/* print a regression and return true if current is worse than baseline by
+ * more than tolerance percent. higher_is_worse is false for throughput */
+static bool regressed(const char *option, const char *metric, double current,
+                      double baseline, double tolerance, bool higher_is_worse) {
+  if (baseline <= 0)
+    return false;
+  double change = (current - baseline) * 100.0 / baseline;
+  if ((higher_is_worse && change <= tolerance) ||
+      (!higher_is_worse && -change <= tolerance))
+    return false;
+  std::cout << "REGRESSION " << option << ": " << metric << " " << current
+            << " vs baseline " << baseline << " (" << (change > 0 ? "+" : "")
+            << change << "%)" << std::endl;
+  return true;
+}
+
+/* number at a path of members of a baseline option
+@return false if some member is missing or is not of the expected type, e.g.
+in a partial baseline or one of an older version */
+static bool baseline_number(const Value &option,
+                            std::initializer_list<const char *> path,
+                            double &number) {
+  const Value *value = &option;
+  for (auto name : path) {
+    if (!value->IsObject())
+      return false;
+    auto member = value->FindMember(name);
+    if (member == value->MemberEnd())
+      return false;
+    value = &member->value;
+  }
+  if (!value->IsNumber())
+    return false;
+  number = value->GetDouble();
+  return true;
+}
+
+int stats_compare_baseline(const std::string &file) {
+  FILE *fp = fopen(file.c_str(), "r");
+  if (fp == nullptr) {
+    std::cerr << "Unable to open baseline file " << file << std::endl;
+    return -1;
+  }
+  char readBuffer[65536];
+  FileReadStream is(fp, readBuffer, sizeof(readBuffer));
+  Document d;
+  d.ParseStream(is);
+  fclose(fp);
+  if (d.HasParseError() || !d.IsObject() || !d.HasMember("options") ||
+      !d["options"].IsObject()) {
+    std::cerr << "Baseline file " << file << " is not a pstress summary"
+              << std::endl;
+    return -1;
+  }
+
+  double tolerance = options->at(Option::BASELINE_TOLERANCE)->getInt();
+  double error_tolerance =
+      options->at(Option::BASELINE_ERROR_TOLERANCE)->getInt();
+  std::lock_guard<std::mutex> lock(run_stats_mutex);
+  int compared = 0, regressions = 0;
+
+  for (size_t i = 0; i < run_stats.options.size(); i++) {
+    auto &stats = run_stats.options[i];
+    if (stats.total < baseline_min_queries)
+      continue;
+    auto name = options->at(i)->getName();
+    auto base = d["options"].FindMember(name);
+    if (base == d["options"].MemberEnd())
+      continue;
+
+    /* an option with missing metrics has no baseline */
+    auto &b = base->value;
+    double base_queries, base_qps, base_p95, base_p99, base_errors;
+    if (!baseline_number(b, {"queries"}, base_queries) ||
+        !baseline_number(b, {"qps"}, base_qps) ||
+        !baseline_number(b, {"latency_us", "p95"}, base_p95) ||
+        !baseline_number(b, {"latency_us", "p99"}, base_p99) ||
+        !baseline_number(b, {"error_rate"}, base_errors) ||
+        base_queries < baseline_min_queries)
+      continue;
+    compared++;
+
+    double qps = run_stats.seconds > 0 ? stats.total / run_stats.seconds : 0;
+    bool worse = false;
+    worse |= regressed(name, "qps", qps, base_qps, tolerance, false);
+    worse |= regressed(name, "p95_us", stats.latency.percentile(95), base_p95,
+                       tolerance, true);
+    worse |= regressed(name, "p99_us", stats.latency.percentile(99), base_p99,
+                       tolerance, true);
+
+    double errors = error_rate(stats.total, stats.success);
+    if (errors - base_errors > error_tolerance) {
+      std::cout << "REGRESSION " << name << ": error_rate " << errors
+                << "% vs baseline " << base_errors << "%" << std::endl;
+      worse = true;
+    }
+    if (worse)
+      regressions++;
+  }
+
+  std::cout << "Baseline comparison with " << file << ": " << regressions
+            << " of " << compared << " options regressed" << std::endl;
+  return regressions;
+}
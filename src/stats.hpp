@@ -0,0 +1,137 @@
+#ifndef __STATS_HPP__
+#define __STATS_HPP__
+
+#include "common.hpp"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Latency histogram in micro-seconds. Values below 16 have their own bucket,
+after that each power of two is split in 16 buckets, so a percentile is off by
+at most 1/16 of its value. Buckets are allocated on first use */
+struct Latency_histogram {
+  static const int SUB_BUCKETS = 16;
+  static const int MAX_BIT = 40; // values above 2^40 us are kept in last bucket
+  static const int BUCKETS = (MAX_BIT - 3) * SUB_BUCKETS;
+
+  void add(uint64_t us);
+  void merge(const Latency_histogram &other);
+  /* value below which p percent of the samples are */
+  uint64_t percentile(double p) const;
+  uint64_t average() const { return count ? sum / count : 0; }
+
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  uint64_t max = 0;
+  std::vector<uint64_t> buckets;
+};
+
+/* Shape of a generated statement, it is filled by the generator so statistics
+can be grouped by shape without parsing the sql */
+struct Statement_shape {
+  enum Predicate {
+    NO_PREDICATE,
+    EQUAL,
+    GREATER_EQUAL,
+    RANGE, // col >= a AND col <= b
+    IN,
+    BETWEEN,
+    NOT_BETWEEN,
+    LIKE
+  };
+  enum Partition_clause { NO_PARTITION_CLAUSE, ONE_PARTITION, PARTITIONS };
+
+  /* pack the shape in an integer to be used as key of the statistics */
+  uint32_t key() const;
+  static Statement_shape from_key(uint32_t key);
+  /* readable form, e.g.
+   * "delete-rows partition(LIST) PARTITION(p) WHERE LIKE" */
+  std::string describe() const;
+  void clear() { *this = Statement_shape(); }
+
+  int option = -1;         // Option::Opt that generated the statement
+  int table_type = -1;     // Table::TABLE_TYPES
+  int partition_type = -1; // Partition::PART_TYPE
+  Partition_clause partition_clause = NO_PARTITION_CLAUSE;
+  Predicate predicate = NO_PREDICATE;
+  bool primary_key = false; // predicate is on the primary key
+};
+
+/* statistics of an option or a statement shape executed in the workload */
+struct Option_stats {
+  unsigned long total = 0;
+  unsigned long success = 0;
+  Latency_histogram latency;
+};
+
+/* initial records inserted in a table */
+struct Load_stats {
+  unsigned long rows = 0;
+  double seconds = 0; // time spent in inserting, summed over threads
+  double index_seconds = 0; // time spent in adding indexes and foreign key
+};
+
+/* statistics of a thread, it is only updated by the owner thread and merged
+ * into the statistics of the run when the thread finishes */
+struct Run_stats {
+  Run_stats() : options(Option::MAX){};
+  void merge(const Run_stats &other);
+
+  std::vector<Option_stats> options;
+  std::unordered_map<uint32_t, Option_stats> shapes; // by Statement_shape::key
+  std::unordered_map<std::string, Option_stats> tables; // by table name
+  std::map<unsigned int, unsigned long> errors;       // by mysql_errno
+
+  /* time of every query split in phases */
+  Latency_histogram send_execute; // mysql_real_query
+  Latency_histogram fetch;        // mysql_store_result
+  Latency_histogram client;       // client output and logging
+  /* queries sampled by --server-timing-sample */
+  Latency_histogram server;   // execution time reported by server
+  Latency_histogram overhead; // send_execute + fetch - server
+  double seconds = 0; // duration of the workload
+  /* --target-qps, delay of the start of operations from their due time */
+  Latency_histogram schedule_lag;
+  unsigned long late_starts = 0; // operations started 1 ms or more late
+  unsigned long backlog = 0;     // operations due but not started at the end
+  std::map<int, Option_stats> phases; // by phase of the workload
+  std::map<int, Option_stats> roles;  // by role of --roles-file
+  double load_seconds = 0; // duration of initial load or check of tables
+  std::map<std::string, Load_stats> table_loads; // by table name
+  unsigned long tables_checked = 0; // by --check-table-preload
+  std::vector<std::string> check_failed_tables;
+};
+
+/* node results for the run report */
+struct Node_report {
+  std::string name;
+  std::string server_version;
+  unsigned long long queries;
+  unsigned long long failed;
+  double wall_seconds;
+};
+
+/* add the statistics of a finished thread to the run */
+void stats_add_thread(const Run_stats &stats);
+
+/* add the results of a finished node to the run */
+void stats_add_node(const Node_report &node);
+
+/* remember option values set by user, so the report can show the ones changed
+ * by pstress later. It is called after parsing the command line */
+void stats_save_requested_options();
+
+/* write the run report. It has the effective options, nodes, load and check
+ * results, per table load throughput, per option and per table throughput,
+ * latency percentiles and error rate, errors, phases of query time and the
+ * --digest-top statement shapes by total and by p99 latency */
+void stats_write_summary(const std::string &file);
+
+/* compare the run with the summary of an earlier run
+@return number of options regressed more than the tolerance, -1 if baseline
+could not be read */
+int stats_compare_baseline(const std::string &file);
+
+#endif
@@ -72,6 +72,10 @@ void Node::workerThread(int number) {
     mysql_options(conn, MYSQL_OPT_MAX_ALLOWED_PACKET, &myParams.maxpacket);
   }
 #endif
+  if (options->at(Option::LOAD_DATA_INFILE)->getBool()) {
+    unsigned int local_infile = 1;
+    mysql_options(conn, MYSQL_OPT_LOCAL_INFILE, &local_infile);
+  }
   if (mysql_real_connect(conn, myParams.address.c_str(),
                          myParams.username.c_str(), myParams.password.c_str(),
                          myParams.database.c_str(), myParams.port,
@@ -89,25 +93,31 @@ void Node::workerThread(int number) {
 
   Thd1 *thd = new Thd1(number, thread_log, general_log, client_log, conn,
                        performed_queries_total, failed_queries_total);
+  {
+    std::lock_guard<std::mutex> lock(thds_mutex);
+    thds.push_back(thd);
+  }
+  server_timing_connect(thd);
+
+  trace_thread_start(myParams.myName + "_thread-" + std::to_string(number));
 
   /* run pstress in with dynamic generator or infile */
   if (options->at(Option::PQUERY)->getBool() == false) {
-    static bool success = false;
+    /* result of load metadata, it is set before metadata_loaded */
+    static std::atomic<bool> success{false};
 
     /* load metadata */
     if (!lock_metadata.test_and_set()) {
       success = thd->load_metadata();
       metadata_loaded = true;
+      phase_changed();
     }
 
-    /* wait untill metadata is finished */
-    while (!metadata_loaded) {
-      std::chrono::seconds dura(3);
-      std::this_thread::sleep_for(dura);
-      thread_log << "waiting for metadata load to finish" << std::endl;
-    }
-
-    if (!success)
+    /* wait untill metadata is finished, a thread that failed meanwhile ends
+     * the wait before the result of load metadata is known */
+    if (!wait_for_phase(
+            thd, [] { return metadata_loaded.load(); }, "metadata load") ||
+        !success)
       thread_log << " initial setup failed, check logs for details "
                  << std::endl;
     else {
@@ -151,7 +161,19 @@ void Node::workerThread(int number) {
       }
     }
   }
+  {
+    std::lock_guard<std::mutex> lock(thds_mutex);
+    thds.erase(std::find(thds.begin(), thds.end(), thd));
+    finished_counts.resize(Option::MAX);
+    for (int i = 0; i < Option::MAX; i++) {
+      auto counts = thd->option_counts(i);
+      finished_counts[i].total += counts.total;
+      finished_counts[i].success += counts.success;
+      finished_counts[i].us += counts.us;
+    }
+  }
   delete thd;
+  trace_thread_end();
 
   if (thread_log.is_open())
     thread_log.close();
@@ -0,0 +1,135 @@
+#include "trace.hpp"
+#include "common.hpp"
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <ostreamwrapper.h>
+#include <writer.h>
+
+using namespace rapidjson;
+
+static std::mutex trace_buffers_mutex;
+static std::vector<std::unique_ptr<Trace_buffer>> trace_buffers;
+static thread_local Trace_buffer *current_buffer = nullptr;
+static const std::chrono::steady_clock::time_point trace_start =
+    std::chrono::steady_clock::now();
+
+bool trace_enabled() {
+  static bool enabled = options->at(Option::TRACE)->getBool();
+  return enabled;
+}
+
+uint64_t trace_now() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - trace_start)
+      .count();
+}
+
+void trace_thread_start(const std::string &thread_name) {
+  if (!trace_enabled())
+    return;
+  size_t max_events = options->at(Option::TRACE_EVENTS)->getInt();
+  std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+  trace_buffers.emplace_back(
+      new Trace_buffer(thread_name, trace_buffers.size() + 1, max_events));
+  current_buffer = trace_buffers.back().get();
+  current_buffer->events.reserve(std::min<size_t>(max_events, 1024 * 64));
+}
+
+void trace_thread_end() { current_buffer = nullptr; }
+
+Trace_span::Trace_span(const char *n, const char *c)
+    : buffer(current_buffer), name(n), cat(c), begin(0) {
+  if (buffer)
+    begin = trace_now();
+}
+
+Trace_span::~Trace_span() {
+  if (buffer == nullptr)
+    return;
+  if (buffer->events.size() >= buffer->max_events) {
+    buffer->dropped++;
+    return;
+  }
+  buffer->events.push_back({name, cat, begin, trace_now() - begin});
+}
+
+void Traced_mutex::lock() {
+  if (current_buffer == nullptr) {
+    mutex.lock();
+    return;
+  }
+  if (mutex.try_lock())
+    return;
+  Trace_span span(name, "lock");
+  mutex.lock();
+}
+
+void trace_dump(const std::string &file) {
+  if (!trace_enabled())
+    return;
+  std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+  std::ofstream of(file, std::ios::out | std::ios::trunc);
+  if (!of.is_open()) {
+    std::cerr << "Unable to open trace file " << file << std::endl;
+    return;
+  }
+
+  OStreamWrapper osw(of);
+  Writer<OStreamWrapper> writer(osw);
+  size_t total = 0, dropped = 0;
+
+  writer.StartObject();
+  writer.String("displayTimeUnit");
+  writer.String("ms");
+  writer.String("traceEvents");
+  writer.StartArray();
+  for (auto &buffer : trace_buffers) {
+    /* metadata event to name the thread */
+    writer.StartObject();
+    writer.String("name");
+    writer.String("thread_name");
+    writer.String("ph");
+    writer.String("M");
+    writer.String("pid");
+    writer.Int(1);
+    writer.String("tid");
+    writer.Int(buffer->tid);
+    writer.String("args");
+    writer.StartObject();
+    writer.String("name");
+    writer.String(buffer->thread_name.c_str(),
+                  static_cast<SizeType>(buffer->thread_name.length()));
+    writer.EndObject();
+    writer.EndObject();
+
+    for (auto &event : buffer->events) {
+      writer.StartObject();
+      writer.String("name");
+      writer.String(event.name);
+      writer.String("cat");
+      writer.String(event.cat);
+      writer.String("ph");
+      writer.String("X");
+      writer.String("ts");
+      writer.Uint64(event.begin);
+      writer.String("dur");
+      writer.Uint64(event.duration);
+      writer.String("pid");
+      writer.Int(1);
+      writer.String("tid");
+      writer.Int(buffer->tid);
+      writer.EndObject();
+    }
+    total += buffer->events.size();
+    dropped += buffer->dropped;
+  }
+  writer.EndArray();
+  writer.EndObject();
+  of << std::endl;
+
+  std::cout << "Saving trace of " << total << " spans to " << file;
+  if (dropped > 0)
+    std::cout << ", " << dropped << " spans dropped, see --trace-events";
+  std::cout << std::endl;
+}
@@ -0,0 +1,78 @@
+#ifndef __TRACE_HPP__
+#define __TRACE_HPP__
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* Client side phase tracing.
+Each thread that calls trace_thread_start() records spans in its own buffer,
+so no locking is needed on the hot path. At exit trace_dump() writes all the
+buffers in Chrome trace-event format, which can be opened in chrome://tracing
+or https://ui.perfetto.dev */
+
+struct Trace_event {
+  const char *name; // must point to a string alive till trace_dump()
+  const char *cat;
+  uint64_t begin; // micro-seconds since start of trace
+  uint64_t duration;
+};
+
+struct Trace_buffer {
+  Trace_buffer(std::string n, int t, size_t max)
+      : thread_name(n), tid(t), max_events(max){};
+  std::string thread_name;
+  int tid;
+  size_t max_events;
+  size_t dropped = 0; // events not recorded because buffer was full
+  std::vector<Trace_event> events;
+};
+
+/* return true if --trace is passed */
+bool trace_enabled();
+
+/* micro-seconds elapsed since start of trace */
+uint64_t trace_now();
+
+/* start recording spans of the calling thread */
+void trace_thread_start(const std::string &thread_name);
+
+/* stop recording spans of the calling thread, the buffer is kept for dump */
+void trace_thread_end();
+
+/* write all thread buffers to a file in Chrome trace-event JSON */
+void trace_dump(const std::string &file);
+
+/* record a span from its construction to its destruction, it is a no-op if
+ * the current thread is not traced */
+class Trace_span {
+public:
+  Trace_span(const char *name, const char *cat);
+  ~Trace_span();
+  Trace_span(const Trace_span &) = delete;
+  Trace_span &operator=(const Trace_span &) = delete;
+
+private:
+  Trace_buffer *buffer;
+  const char *name;
+  const char *cat;
+  uint64_t begin;
+};
+
+/* mutex that records the time spent waiting for it. Uncontended lock does not
+ * produce any span */
+class Traced_mutex {
+public:
+  Traced_mutex(const char *n) : name(n){};
+  void lock();
+  void unlock() { mutex.unlock(); }
+  bool try_lock() { return mutex.try_lock(); }
+
+private:
+  std::mutex mutex;
+  const char *name;
+};
+
+#endif